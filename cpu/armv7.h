@@ -25,7 +25,6 @@ struct rt_hw_exp_stack
 
 struct rt_hw_stack
 {
-	unsigned long cpsr;
 	unsigned long r0;
 	unsigned long r1;
 	unsigned long r2;
@@ -41,6 +40,7 @@ struct rt_hw_stack
 	unsigned long ip;
 	unsigned long lr;
 	unsigned long pc;
+	unsigned long cpsr;
 };
 
 #define USERMODE    0x10
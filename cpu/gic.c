@@ -96,8 +96,10 @@ void gic_set_irq_security(uint32_t irqID, bool isSecure)
     uint32_t reg = irq_get_register_offset(irqID);
     uint32_t mask = irq_get_bit_mask(irqID);
     
+    // Secure interrupts are group 0 and signalled as FIQ, the others are
+    // group 1 and signalled as IRQ.
     uint32_t value = gicd->IGROUPRn[reg];
-    if (!isSecure)
+    if (isSecure)
     {
         value &= ~mask;
     }
@@ -161,8 +163,12 @@ void gic_send_sgi(uint32_t irqID, uint32_t target_list, uint32_t filter_list)
 {
     gicd_t * gicd = gic_get_gicd();
     
+    // A secure write only forwards group 1 SGIs with NSATT set.
+    uint32_t nsatt = (gicd->IGROUPRn[0] & irq_get_bit_mask(irqID & 0xf)) ? kBM_GICD_SGIR_NSATT : 0;
+
     gicd->SGIR = (filter_list << kBP_GICD_SGIR_TargetListFilter)
                     | (target_list << kBP_GICD_SGIR_CPUTargetList)
+                    | nsatt
                     | (irqID & 0xf);
 }
 
@@ -198,6 +204,18 @@ void gic_write_end_of_irq(uint32_t irqID)
     gicc->EOIR = irqID;
 }
 
+uint32_t gic_read_irq_ack_ns(void)
+{
+    gicc_t * gicc = gic_get_gicc();
+    return gicc->AIAR;
+}
+
+void gic_write_end_of_irq_ns(uint32_t irqID)
+{
+    gicc_t * gicc = gic_get_gicc();
+    gicc->AEOIR = irqID;
+}
+
 void gic_init(void)
 {
     gicd_t * gicd = gic_get_gicd();
@@ -230,9 +248,15 @@ void gic_init_cpu(void)
     // Init the GIC CPU interface.
     gic_set_cpu_priority_mask(0xff);
 
-    // Disable preemption.
+    // All implemented priority bits are group priority, so every more
+    // urgent level preempts. The GIC raises a value below its minimum.
     gicc_t * gicc = gic_get_gicc();
-    gicc->BPR = 7;
+    gicc->BPR = 2;
+
+    // Group 0 interrupts are signalled as FIQ, and group 1 uses the same
+    // binary point. Group 1 is acknowledged through the aliased registers,
+    // so IAR never hands a group 1 interrupt to the FIQ handler.
+    gicc->CTLR = (gicc->CTLR & ~kBM_GICC_CTLR_AckCtl) | kBM_GICC_CTLR_FIQEn | kBM_GICC_CTLR_SBPR;
 
     // Enable signaling the CPU.
     gic_cpu_enable(true);
@@ -83,7 +83,8 @@ void gic_init(void);
 //! @brief Init the current CPU's GIC interface.
 //!
 //! @post Enables the CPU interface and sets the priority mask to 255. Interrupt preemption
-//!     is disabled by setting the Binary Point to a value of 7.
+//!     is enabled for every priority level by setting the Binary Point to 2. Group 0
+//!     interrupts are signalled as FIQ.
 void gic_init_cpu(void);
 //@}
 
@@ -99,6 +100,9 @@ void gic_enable(bool enableIt);
 
 //! @brief Set the security mode for an interrupt.
 //!
+//! Secure interrupts are group 0 and signalled to the CPU as FIQ, non-secure ones are
+//! group 1 and signalled as IRQ.
+//!
 //! @param irqID The interrupt number.
 //! @param isSecure Whether the interrupt is taken to secure mode.
 void gic_set_irq_security(uint32_t irqID, bool isSecure);
@@ -169,6 +173,14 @@ uint32_t gic_read_irq_ack(void);
 //!
 //! @param irq_id The number of the interrupt for which handling has finished.
 void gic_write_end_of_irq(uint32_t irq_id);
+
+//! @brief Acknowledge a group 1 (IRQ) interrupt through the aliased register.
+//!
+//! @return The number of the highest priority group 1 interrupt, or 1023.
+uint32_t gic_read_irq_ack_ns(void);
+
+//! @brief Signal the end of a group 1 interrupt acknowledged by gic_read_irq_ack_ns().
+void gic_write_end_of_irq_ns(uint32_t irq_id);
 //@}
 
 
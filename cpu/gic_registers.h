@@ -110,7 +110,10 @@ struct _gicc_registers
     uint32_t RPR;   //!< Running Priority Register.
     uint32_t HPPIR; //!< Highest Priority Pending Interrupt Register.
     uint32_t ABPR;  //!< Aliased Binary Point Register. (only visible with a secure access)
-    uint32_t _reserved[56];
+    uint32_t AIAR;  //!< Aliased Interrupt Acknowledge Register. (only visible with a secure access)
+    uint32_t AEOIR; //!< Aliased End of Interrupt Register. (only visible with a secure access)
+    uint32_t AHPPIR;//!< Aliased Highest Priority Pending Interrupt Register. (only visible with a secure access)
+    uint32_t _reserved[52];
     uint32_t IIDR;  //!< CPU Interface Identification Register.
 };
 
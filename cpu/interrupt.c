@@ -17,19 +17,111 @@
 #include <rtthread.h>
 #include <interrupt.h>
 #include <gic.h>
+#include <board.h>
+#include <pmu.h>
 
 /* exception and interrupt handler table */
 #define MAX_HANDLERS 160
 struct rt_irq_desc isr_table[MAX_HANDLERS];
+static rt_uint8_t isr_priority[MAX_HANDLERS];
 extern volatile rt_uint8_t rt_interrupt_nest;
 rt_uint32_t rt_interrupt_from_thread;
 rt_uint32_t rt_interrupt_to_thread;
 rt_uint32_t rt_thread_switch_interrupt_flag;
 
+#ifdef RT_USING_INTERRUPT_INFO
+/*
+ * Handler time per vector in clocksource counts. A handler's own time
+ * leaves out the nested handlers that preempted it, they are charged to
+ * their own vector. Latency is from the source raising the interrupt to
+ * rt_hw_trap_irq, for vectors with a probe that knows when that was.
+ */
+#define IRQ_HIST_NUM    16      /* log2 buckets of the handler time */
+
+struct irq_stat
+{
+    rt_uint32_t min, max;
+    rt_uint64_t sum;
+    rt_uint32_t hist[IRQ_HIST_NUM];
+
+    rt_irq_raised_t raised;
+    rt_uint32_t lat_count;
+    rt_uint32_t lat_min, lat_max;
+    rt_uint64_t lat_sum;
+};
+static struct irq_stat isr_stat[MAX_HANDLERS];
+/* handler time spent so far in all nested levels, see rt_hw_interrupt_stat_leave */
+static rt_uint64_t isr_time;
+static rt_uint64_t isr_stat_since;
+
+static void irq_stat_reset(struct irq_stat *stat)
+{
+    rt_irq_raised_t raised = stat->raised;
+
+    rt_memset(stat, 0, sizeof(*stat));
+    stat->min = ~0u;
+    stat->lat_min = ~0u;
+    stat->raised = raised;
+}
+
+/* called by rt_hw_trap_irq with IRQs masked, returns what to hand to leave */
+rt_uint64_t rt_hw_interrupt_stat_enter(int vector, rt_uint64_t entry)
+{
+    struct irq_stat *stat = &isr_stat[vector];
+    rt_uint64_t raised;
+    rt_uint32_t lat;
+
+    if (stat->raised)
+    {
+        raised = stat->raised(vector);
+        if (raised && raised <= entry)
+        {
+            lat = (rt_uint32_t)(entry - raised);
+            if (lat < stat->lat_min) stat->lat_min = lat;
+            if (lat > stat->lat_max) stat->lat_max = lat;
+            stat->lat_sum += lat;
+            stat->lat_count++;
+        }
+    }
+    return isr_time;
+}
+
+void rt_hw_interrupt_stat_leave(int vector, rt_uint64_t entry, rt_uint64_t time)
+{
+    struct irq_stat *stat = &isr_stat[vector];
+    rt_uint64_t total = get_ticks() - entry;
+    rt_uint32_t self;
+    int b;
+
+    /* a preempted level sees this handler's whole time as nested */
+    self = (rt_uint32_t)(total - (isr_time - time));
+    isr_time = time + total;
+
+    if (self < stat->min) stat->min = self;
+    if (self > stat->max) stat->max = self;
+    stat->sum += self;
+    b = self ? 32 - __builtin_clz(self) : 0;
+    if (b >= IRQ_HIST_NUM) b = IRQ_HIST_NUM - 1;
+    stat->hist[b]++;
+}
+
+/**
+ * This function will set the latency probe of a interrupt.
+ * @param vector the interrupt number
+ * @param raised returns the clocksource count the source raised the
+ *               interrupt at, or 0 when it does not know
+ */
+void rt_hw_interrupt_set_raised(int vector, rt_irq_raised_t raised)
+{
+    if (vector < MAX_HANDLERS)
+        isr_stat[vector].raised = raised;
+}
+#endif /* RT_USING_INTERRUPT_INFO */
+
 void enable_interrupt(uint32_t irq_id, uint32_t cpu_id, uint32_t priority)
 {
     gic_set_irq_priority(irq_id, priority);
-    gic_set_irq_security(irq_id, false);    // set IRQ as non-secure
+    gic_set_irq_security(irq_id, false);    // set IRQ as non-secure, group 1
     gic_set_cpu_target(irq_id, cpu_id, true);
     gic_enable_irq(irq_id, true);
 }
@@ -49,6 +141,13 @@ void rt_hw_interrupt_init(void)
 
     /* init exceptions table */
     rt_memset(isr_table, 0x00, sizeof(isr_table));
+    rt_memset(isr_priority, IRQ_PRIO_DEFAULT, sizeof(isr_priority));
+#ifdef RT_USING_INTERRUPT_INFO
+    {
+        int i;
+        for (i = 0; i < MAX_HANDLERS; i++) irq_stat_reset(&isr_stat[i]);
+    }
+#endif
 
     /* init interrupt nest, and context in thread sp */
     rt_interrupt_nest = 0;
@@ -72,7 +171,44 @@ void rt_hw_interrupt_mask(int vector)
  */
 void rt_hw_interrupt_umask(int vector)
 {
-    enable_interrupt(vector, 0, 0);
+    enable_interrupt(vector, 0, isr_priority[vector]);
+}
+
+/**
+ * This function will set the priority of a interrupt, see IRQ_PRIO_*.
+ * @param vector the interrupt number
+ * @param priority 0 is the most urgent, 255 the least
+ */
+void rt_hw_interrupt_set_priority(int vector, unsigned int priority)
+{
+    if (vector < MAX_HANDLERS)
+    {
+        isr_priority[vector] = priority;
+        gic_set_irq_priority(vector, priority);
+    }
+}
+
+/**
+ * This function will un-mask a interrupt as FIQ, see board.h.
+ * @param vector the interrupt number
+ */
+void rt_hw_interrupt_umask_fiq(int vector)
+{
+    if (vector < MAX_HANDLERS)
+    {
+        isr_priority[vector] = IRQ_PRIO_FIQ;
+        gic_set_irq_priority(vector, IRQ_PRIO_FIQ);
+        gic_set_irq_security(vector, true);     // group 0 is signalled as FIQ
+        gic_set_cpu_target(vector, 0, true);
+        gic_enable_irq(vector, true);
+    }
+}
+
+unsigned int rt_hw_interrupt_get_priority(int vector)
+{
+    if (vector < MAX_HANDLERS)
+        return isr_priority[vector];
+    return 0xff;
 }
 
 /**
@@ -95,6 +231,7 @@ rt_isr_handler_t rt_hw_interrupt_install(int vector, rt_isr_handler_t handler,
 #ifdef RT_USING_INTERRUPT_INFO
             rt_strncpy(isr_table[vector].name, name, RT_NAME_MAX);
             isr_table[vector].counter = 0;
+            irq_stat_reset(&isr_stat[vector]);
 #endif /* RT_USING_INTERRUPT_INFO */
             isr_table[vector].handler = handler;
             isr_table[vector].param = param;
@@ -106,24 +243,330 @@ rt_isr_handler_t rt_hw_interrupt_install(int vector, rt_isr_handler_t handler,
 }
 
 #ifdef RT_USING_FINSH
-void list_irq(void)
+#include <finsh.h>
+#include <stdlib.h>
+
+#define COUNTS_NS(c)    ((rt_uint32_t)((rt_uint64_t)(c) * 125 / 3))
+
+#ifdef RT_USING_INTERRUPT_INFO
+static void list_irq_hist(int irq)
+{
+    struct irq_stat *stat = &isr_stat[irq];
+    int b;
+
+    rt_kprintf("nr:%4d %.*s handler time\n", irq, RT_NAME_MAX, isr_table[irq].name);
+    for (b = 0; b < IRQ_HIST_NUM; b++)
+    {
+        if (stat->hist[b] == 0) continue;
+        if (b == IRQ_HIST_NUM - 1)
+            rt_kprintf(" >= %8d ns %8d\n", COUNTS_NS(1 << (b - 1)), stat->hist[b]);
+        else
+            rt_kprintf("  < %8d ns %8d\n", COUNTS_NS(1 << b), stat->hist[b]);
+    }
+}
+#endif
+
+/* list_irq [reset | nr] */
+long list_irq(int argc, char **argv)
 {
     int irq;
+#ifdef RT_USING_INTERRUPT_INFO
+    struct irq_stat *stat;
+    rt_uint64_t elapsed;
+    rt_base_t level;
+
+    if (argc > 1 && !rt_strncmp(argv[1], "reset", 6))
+    {
+        level = rt_hw_interrupt_disable();
+        for (irq = 0; irq < MAX_HANDLERS; irq++)
+        {
+            isr_table[irq].counter = 0;
+            irq_stat_reset(&isr_stat[irq]);
+        }
+        isr_stat_since = get_ticks();
+        rt_hw_interrupt_enable(level);
+        return 0;
+    }
+    if (argc > 1)
+    {
+        irq = atol(argv[1]);
+        if (irq < 0 || irq >= MAX_HANDLERS) return -1;
+        list_irq_hist(irq);
+        return 0;
+    }
+
+    elapsed = get_ticks() - isr_stat_since;
+    rt_kprintf("nr   name     count      cpu  avg ns   max ns  lat avg  lat max\n");
     for (irq = 0; irq < MAX_HANDLERS; irq++)
     {
         if (!isr_table[irq].handler) continue;
-#ifdef RT_USING_INTERRUPT_INFO
-        rt_kprintf("nr:%4d, name: %*.s, count: %8d, handler: 0x%p, param: 0x%08x\r\n",
-                irq, RT_NAME_MAX, isr_table[irq].name, isr_table[irq].counter,
-                isr_table[irq].handler, isr_table[irq].param);
+        stat = &isr_stat[irq];
+        rt_kprintf("%4d %-*.*s %8d %3d.%02d%% %7d %8d",
+                irq, RT_NAME_MAX, RT_NAME_MAX, isr_table[irq].name, isr_table[irq].counter,
+                (int)(stat->sum * 100 / elapsed), (int)(stat->sum * 10000 / elapsed % 100),
+                isr_table[irq].counter ? COUNTS_NS(stat->sum / isr_table[irq].counter) : 0,
+                COUNTS_NS(stat->max));
+        if (stat->lat_count)
+            rt_kprintf(" %8d %8d\n", COUNTS_NS(stat->lat_sum / stat->lat_count), COUNTS_NS(stat->lat_max));
+        else
+            rt_kprintf("        -        -\n");
+    }
 #else
+    for (irq = 0; irq < MAX_HANDLERS; irq++)
+    {
+        if (!isr_table[irq].handler) continue;
         rt_kprintf("nr:%4d, handler: 0x%p, param: 0x%08x\r\n",
                 irq, isr_table[irq].handler, isr_table[irq].param);
+    }
 #endif
+
+    return 0;
+}
+MSH_CMD_EXPORT(list_irq, list system irq: [reset | nr for its handler time histogram]);
+
+/* software interrupts this cpu raises for itself in irq_nest_test */
+#define NEST_SGI_LOW    1
+#define NEST_SGI_HIGH   2
+#define NEST_LOW_US     50
+
+static volatile rt_uint64_t nest_sent, nest_high;
+static volatile int nest_preempted;
+
+static void nest_high_isr(int vector, void *param)
+{
+    nest_high = get_ticks();
+}
+
+/* a slow handler that raises an urgent interrupt early on */
+static void nest_low_isr(int vector, void *param)
+{
+    rt_uint64_t end;
+
+    nest_sent = get_ticks();
+    gic_send_sgi(NEST_SGI_HIGH, 0, kGicSgiFilter_OnlyThisCPU);
+    end = nest_sent + NEST_LOW_US * 24;
+    while (get_ticks() < end) ;
+    nest_preempted = nest_high != 0;
+}
+
+int irq_nest_test(int argc, char **argv)
+{
+    int i, count = 1000, preempted = 0, done = 0;
+    rt_uint32_t lat, min = ~0u, max = 0;
+    rt_uint64_t sum = 0, timeout;
+
+    if (argc > 1) count = atol(argv[1]);
+
+    rt_hw_interrupt_install(NEST_SGI_LOW, nest_low_isr, RT_NULL, "nestlow");
+    rt_hw_interrupt_install(NEST_SGI_HIGH, nest_high_isr, RT_NULL, "nesthigh");
+    rt_hw_interrupt_set_priority(NEST_SGI_LOW, IRQ_PRIO_BULK);
+    rt_hw_interrupt_set_priority(NEST_SGI_HIGH, IRQ_PRIO_TICK);
+    rt_hw_interrupt_umask(NEST_SGI_LOW);
+    rt_hw_interrupt_umask(NEST_SGI_HIGH);
+
+    for (i = 0; i < count; i++)
+    {
+        nest_high = 0;
+        nest_preempted = -1;
+        gic_send_sgi(NEST_SGI_LOW, 0, kGicSgiFilter_OnlyThisCPU);
+        timeout = get_ticks() + 24 * 1000;
+        while ((nest_preempted < 0 || nest_high == 0) && get_ticks() < timeout) ;
+        if (nest_preempted < 0 || nest_high == 0) break;
+
+        lat = (rt_uint32_t)(nest_high - nest_sent) * 125 / 3;
+        if (lat < min) min = lat;
+        if (lat > max) max = lat;
+        sum += lat;
+        preempted += nest_preempted;
+        done++;
     }
+
+    rt_hw_interrupt_mask(NEST_SGI_LOW);
+    rt_hw_interrupt_mask(NEST_SGI_HIGH);
+
+    if (done < count)
+        rt_kprintf("interrupt not taken after %d rounds\n", done);
+    if (done == 0) return -1;
+    rt_kprintf("urgent irq raised in a %d us handler: preempted it %d/%d times\n",
+        NEST_LOW_US, preempted, done);
+    rt_kprintf("raise to handler latency min %d avg %d max %d ns\n",
+        min, (int)(sum / done), max);
+
+    return 0;
 }
+MSH_CMD_EXPORT(irq_nest_test, check that urgent interrupts preempt slow handlers: [count]);
 
-#include <finsh.h>
-FINSH_FUNCTION_EXPORT(list_irq, list system irq);
-MSH_CMD_EXPORT(list_irq, list system irq);
+#define FIQ_TEST_SGI    3
+
+static volatile rt_uint64_t fiq_test_taken;
+
+static void fiq_test_isr(int vector, void *param)
+{
+    fiq_test_taken = get_ticks();
+}
+
+/* raise the SGI count times, latencies in ns */
+static int fiq_test_round(const char *name, int count, int irqs_off)
+{
+    int i, done = 0;
+    rt_uint32_t lat, min = ~0u, max = 0;
+    rt_uint64_t sum = 0, sent, timeout;
+    rt_base_t level = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        fiq_test_taken = 0;
+        if (irqs_off) level = rt_hw_interrupt_disable();
+        sent = get_ticks();
+        gic_send_sgi(FIQ_TEST_SGI, 0, kGicSgiFilter_OnlyThisCPU);
+        timeout = sent + 24 * 1000;
+        while (fiq_test_taken == 0 && get_ticks() < timeout) ;
+        if (irqs_off) rt_hw_interrupt_enable(level);
+        if (fiq_test_taken == 0) break;
+
+        lat = (rt_uint32_t)(fiq_test_taken - sent) * 125 / 3;
+        if (lat < min) min = lat;
+        if (lat > max) max = lat;
+        sum += lat;
+        done++;
+    }
+
+    if (done == 0)
+    {
+        rt_kprintf("%-14s not taken\n", name);
+        return -1;
+    }
+    rt_kprintf("%-14s %5d raised, latency min %5d avg %5d max %5d ns\n",
+        name, done, min, (int)(sum / done), max);
+    return 0;
+}
+
+int fiq_test(int argc, char **argv)
+{
+    int count = 1000;
+
+    if (argc > 1) count = atol(argv[1]);
+
+    rt_hw_interrupt_install(FIQ_TEST_SGI, fiq_test_isr, RT_NULL, "fiqtest");
+
+    rt_hw_interrupt_set_priority(FIQ_TEST_SGI, IRQ_PRIO_HRTIMER);
+    rt_hw_interrupt_umask(FIQ_TEST_SGI);
+    fiq_test_round("irq", count, 0);
+
+    rt_hw_interrupt_umask_fiq(FIQ_TEST_SGI);
+    fiq_test_round("fiq", count, 0);
+    fiq_test_round("fiq, irqs off", count, 1);
+
+    rt_hw_interrupt_mask(FIQ_TEST_SGI);
+
+    return 0;
+}
+MSH_CMD_EXPORT(fiq_test, irq and fiq entry latency from a software interrupt: [count]);
+
+#define SWITCH_SGI      5
+
+struct switch_stat
+{
+    rt_uint32_t min, max, count;
+    rt_uint64_t sum;
+};
+
+static struct rt_semaphore switch_sem;
+static volatile rt_uint32_t switch_isr_at, switch_woken_at;
+static volatile int switch_quit;
+
+static void switch_stat_add(struct switch_stat *stat, rt_uint32_t cycles)
+{
+    if (cycles < stat->min) stat->min = cycles;
+    if (cycles > stat->max) stat->max = cycles;
+    stat->sum += cycles;
+    stat->count++;
+}
+
+static void switch_stat_show(const char *name, struct switch_stat *stat)
+{
+    if (stat->count == 0) return;
+    rt_kprintf("%-18s min %5d avg %5d max %6d cycles\n", name,
+        stat->min, (int)(stat->sum / stat->count), stat->max);
+}
+
+static void switch_isr(int vector, void *param)
+{
+    switch_isr_at = pmu_get_cycle();
+    rt_sem_release(&switch_sem);
+}
+
+/* above the shell, every release preempts it straight away */
+static void switch_thread_entry(void *parameter)
+{
+    while (!switch_quit)
+    {
+        rt_sem_take(&switch_sem, RT_WAITING_FOREVER);
+        switch_woken_at = pmu_get_cycle();
+    }
+}
+
+/* cpu cycles, not clocksource counts, from a release or an interrupt until the woken thread runs */
+int switch_bench(int argc, char **argv)
+{
+    struct switch_stat thread = {~0u}, entry = {~0u}, leave = {~0u}, irq = {~0u};
+    rt_uint32_t start;
+    rt_uint64_t timeout;
+    rt_thread_t tid;
+    int i, count = 1000, ret = 0;
+
+    if (argc > 1) count = atol(argv[1]);
+
+    switch_quit = 0;
+    rt_sem_init(&switch_sem, "swbench", 0, RT_IPC_FLAG_FIFO);
+    tid = rt_thread_create("swbench", switch_thread_entry, RT_NULL, 1024, 3, 10);
+    if (tid == RT_NULL)
+    {
+        rt_sem_detach(&switch_sem);
+        return -1;
+    }
+    rt_thread_startup(tid);
+    rt_hw_interrupt_install(SWITCH_SGI, switch_isr, RT_NULL, "swbench");
+    rt_hw_interrupt_umask(SWITCH_SGI);
+
+    /* voluntary: rt_sem_release, rt_schedule and rt_hw_context_switch */
+    for (i = 0; i < count; i++)
+    {
+        start = pmu_get_cycle();
+        rt_sem_release(&switch_sem);
+        switch_stat_add(&thread, switch_woken_at - start);
+    }
+
+    /* preemptive: vector_irq, the handler and the switch on its way out */
+    for (i = 0; i < count; i++)
+    {
+        switch_woken_at = 0;
+        start = pmu_get_cycle();
+        gic_send_sgi(SWITCH_SGI, 0, kGicSgiFilter_OnlyThisCPU);
+        timeout = get_ticks() + 24 * 1000;
+        while (switch_woken_at == 0 && get_ticks() < timeout) ;
+        if (switch_woken_at == 0)
+        {
+            rt_kprintf("irq to thread not taken after %d rounds\n", i);
+            ret = -1;
+            break;
+        }
+        switch_stat_add(&entry, switch_isr_at - start);
+        switch_stat_add(&leave, switch_woken_at - switch_isr_at);
+        switch_stat_add(&irq, switch_woken_at - start);
+    }
+
+    rt_hw_interrupt_mask(SWITCH_SGI);
+    switch_quit = 1;
+    rt_sem_release(&switch_sem);
+    rt_sem_detach(&switch_sem);
+
+    switch_stat_show("thread to thread", &thread);
+    switch_stat_show("irq to handler", &entry);
+    switch_stat_show("handler to thread", &leave);
+    switch_stat_show("irq to thread", &irq);
+
+    return ret;
+}
+MSH_CMD_EXPORT(switch_bench, thread to thread and irq to thread switch cycles: [count]);
 #endif
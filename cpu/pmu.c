@@ -0,0 +1,355 @@
+/*
+ * File      : pmu.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2013-2014, RT-Thread Development Team
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rt-thread.org/license/LICENSE
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <pmu.h>
+
+#define PMCR_E                  (1 << 0)    /* enable all counters */
+#define PMCR_P                  (1 << 1)    /* reset the event counters */
+#define PMCR_C                  (1 << 2)    /* reset the cycle counter */
+#define PMCNTEN_CYCLE           (1u << 31)
+
+/* threads accounted for separately, the rest and the gone share one entry */
+#ifndef RT_PMU_THREAD_NUM
+#define RT_PMU_THREAD_NUM       32
+#endif
+
+struct pmu_thread
+{
+    rt_thread_t thread;
+    char name[RT_NAME_MAX];
+    rt_uint64_t cycles;
+    rt_uint64_t count[PMU_EVENT_NUM];
+};
+
+/* a slot given back, probing goes on past it */
+#define PMU_THREAD_GONE         ((rt_thread_t)1)
+
+static struct pmu_thread pmu_thread[RT_PMU_THREAD_NUM];
+static struct pmu_thread pmu_other = {RT_NULL, "(other)"};
+static struct pmu_thread *pmu_current = &pmu_other;
+
+/* counter values at the last switch */
+static rt_uint32_t pmu_last_cycle, pmu_last[PMU_EVENT_NUM];
+
+/* what perf shows by default: ipc, L1 data miss rate and mispredicts */
+static const rt_uint32_t pmu_default_event[PMU_EVENT_NUM] =
+{
+    PMU_EV_INST_RETIRED, PMU_EV_L1D_ACCESS, PMU_EV_L1D_REFILL, PMU_EV_BR_MIS_PRED,
+};
+
+/*
+ * PMSELR picks the counter PMXEVTYPER and PMXEVCNTR go to. The scheduler
+ * hook and the tick select counters of their own, so select and access
+ * happen with interrupts off.
+ */
+static rt_uint32_t pmu_read_counter(int counter)
+{
+    rt_uint32_t count;
+
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 5" : : "r"(counter));   /* PMSELR */
+    __asm__ volatile ("isb");
+    __asm__ volatile ("mrc p15, 0, %0, c9, c13, 2" : "=r"(count));     /* PMXEVCNTR */
+    return count;
+}
+
+void pmu_set_event(int counter, rt_uint32_t event)
+{
+    rt_base_t level;
+
+    RT_ASSERT(counter >= 0 && counter < PMU_EVENT_NUM);
+
+    level = rt_hw_interrupt_disable();
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 5" : : "r"(counter));
+    __asm__ volatile ("isb");
+    __asm__ volatile ("mcr p15, 0, %0, c9, c13, 1" : : "r"(event));     /* PMXEVTYPER */
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 1" : : "r"(1 << counter)); /* PMCNTENSET */
+    rt_hw_interrupt_enable(level);
+}
+
+rt_uint32_t pmu_get_event(int counter)
+{
+    rt_uint32_t event;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 5" : : "r"(counter));
+    __asm__ volatile ("isb");
+    __asm__ volatile ("mrc p15, 0, %0, c9, c13, 1" : "=r"(event));
+    rt_hw_interrupt_enable(level);
+    return event & 0xff;
+}
+
+rt_uint32_t pmu_get_counter(int counter)
+{
+    rt_uint32_t count;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    count = pmu_read_counter(counter);
+    rt_hw_interrupt_enable(level);
+    return count;
+}
+
+/* call with interrupts off */
+static void pmu_charge(void)
+{
+    rt_uint32_t now;
+    int i;
+
+    /* 32 bit deltas, right as long as nothing runs 3 s without a switch or a tick */
+    now = pmu_get_cycle();
+    pmu_current->cycles += now - pmu_last_cycle;
+    pmu_last_cycle = now;
+    for (i = 0; i < PMU_EVENT_NUM; i++)
+    {
+        now = pmu_read_counter(i);
+        pmu_current->count[i] += now - pmu_last[i];
+        pmu_last[i] = now;
+    }
+}
+
+/* call with interrupts off */
+static struct pmu_thread *pmu_find(rt_thread_t thread)
+{
+    struct pmu_thread *p, *gone = RT_NULL;
+    rt_uint32_t i, slot;
+
+    /* thread control blocks are at least 8 byte aligned */
+    slot = ((rt_uint32_t)thread >> 3) % RT_PMU_THREAD_NUM;
+    for (i = 0; i < RT_PMU_THREAD_NUM; i++)
+    {
+        p = &pmu_thread[(slot + i) % RT_PMU_THREAD_NUM];
+
+        if (p->thread == thread) return p;
+        if (p->thread == PMU_THREAD_GONE && gone == RT_NULL) gone = p;
+        if (p->thread == RT_NULL) break;
+    }
+    if (i == RT_PMU_THREAD_NUM) p = RT_NULL;
+
+    /* not there, reuse the first given back slot on the way */
+    if (gone) p = gone;
+    if (p == RT_NULL) return &pmu_other;
+    p->thread = thread;
+    rt_strncpy(p->name, thread->name, RT_NAME_MAX);
+    return p;
+}
+
+/* rt_schedule calls this with interrupts off, before it switches */
+static void pmu_scheduler_hook(rt_thread_t from, rt_thread_t to)
+{
+    pmu_charge();
+    pmu_current = pmu_find(to);
+}
+
+/*
+ * A deleted or detached thread gives its slot back, what it used goes
+ * to (other) so the totals still add up. Called from the board's object
+ * detach hook, at times with interrupts already off.
+ */
+void pmu_thread_detach(rt_thread_t thread)
+{
+    struct pmu_thread *p;
+    rt_base_t level;
+    rt_uint32_t i, slot;
+    int j;
+
+    level = rt_hw_interrupt_disable();
+    slot = ((rt_uint32_t)thread >> 3) % RT_PMU_THREAD_NUM;
+    for (i = 0; i < RT_PMU_THREAD_NUM; i++)
+    {
+        p = &pmu_thread[(slot + i) % RT_PMU_THREAD_NUM];
+
+        if (p->thread == RT_NULL) break;
+        if (p->thread != thread) continue;
+
+        if (pmu_current == p)
+        {
+            pmu_charge();
+            pmu_current = &pmu_other;
+        }
+        pmu_other.cycles += p->cycles;
+        for (j = 0; j < PMU_EVENT_NUM; j++) pmu_other.count[j] += p->count[j];
+        rt_memset(p, 0, sizeof(struct pmu_thread));
+        p->thread = PMU_THREAD_GONE;
+        break;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+void pmu_account(void)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    pmu_charge();
+    rt_hw_interrupt_enable(level);
+}
+
+static void pmu_reset(void)
+{
+    rt_base_t level;
+    int i;
+
+    level = rt_hw_interrupt_disable();
+    pmu_charge();
+    rt_memset(pmu_thread, 0, sizeof(pmu_thread));
+    pmu_other.cycles = 0;
+    rt_memset(pmu_other.count, 0, sizeof(pmu_other.count));
+    pmu_current = pmu_find(rt_thread_self());
+    for (i = 0; i < PMU_EVENT_NUM; i++) pmu_last[i] = pmu_read_counter(i);
+    rt_hw_interrupt_enable(level);
+}
+
+void rt_hw_pmu_init(void)
+{
+    rt_uint32_t pmcr;
+    int i;
+
+    __asm__ volatile ("mrc p15, 0, %0, c9, c12, 0" : "=r"(pmcr));
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 0" : : "r"(pmcr | PMCR_E | PMCR_P | PMCR_C));
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 1" : : "r"(PMCNTEN_CYCLE));
+    for (i = 0; i < PMU_EVENT_NUM; i++) pmu_set_event(i, pmu_default_event[i]);
+
+#ifdef RT_USING_HOOK
+    rt_scheduler_sethook(pmu_scheduler_hook);
+#endif
+}
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#include <stdlib.h>
+
+static const struct
+{
+    rt_uint32_t event;
+    const char *name;
+} pmu_event_name[] =
+{
+    {PMU_EV_L1I_REFILL,   "l1i_refill"},
+    {PMU_EV_L1D_REFILL,   "l1d_refill"},
+    {PMU_EV_L1D_ACCESS,   "l1d_access"},
+    {PMU_EV_INST_RETIRED, "instr"},
+    {PMU_EV_EXC_TAKEN,    "exception"},
+    {PMU_EV_BR_MIS_PRED,  "br_mispred"},
+    {PMU_EV_CPU_CYCLES,   "cycles"},
+    {PMU_EV_BR_PRED,      "br_pred"},
+    {PMU_EV_L2D_ACCESS,   "l2d_access"},
+    {PMU_EV_L2D_REFILL,   "l2d_refill"},
+};
+
+/* counter counting event, -1 if none */
+static int pmu_counter_of(rt_uint32_t event)
+{
+    int i;
+
+    for (i = 0; i < PMU_EVENT_NUM; i++)
+        if (pmu_get_event(i) == event) return i;
+    return -1;
+}
+
+static void pmu_show_header(void)
+{
+    rt_uint32_t event;
+    int i, j;
+
+    rt_kprintf("%-*.*s %12s %6s %5s %6s", RT_NAME_MAX, RT_NAME_MAX, "thread",
+        "kcycles", "cpu%", "ipc", "miss%");
+    for (i = 0; i < PMU_EVENT_NUM; i++)
+    {
+        event = pmu_get_event(i);
+        for (j = 0; j < sizeof(pmu_event_name) / sizeof(pmu_event_name[0]); j++)
+            if (pmu_event_name[j].event == event) break;
+        if (j < sizeof(pmu_event_name) / sizeof(pmu_event_name[0]))
+            rt_kprintf(" %10s k", pmu_event_name[j].name);
+        else
+            rt_kprintf("   event %02x k", event);
+    }
+    rt_kprintf("\n");
+}
+
+/* scale * a / b with two decimals, a dash when b is zero */
+static void pmu_show_ratio(rt_uint64_t a, rt_uint64_t b, int scale, int width)
+{
+    rt_uint32_t r;
+
+    if (b == 0)
+    {
+        rt_kprintf(" %*s", width, "-");
+        return;
+    }
+    r = (rt_uint32_t)(a * scale * 100 / b);
+    rt_kprintf(" %*d.%02d", width - 3, r / 100, r % 100);
+}
+
+/* counts in thousands, rt_kprintf has no 64 bit conversion */
+static void pmu_show(struct pmu_thread *p, rt_uint64_t total, int instr, int access, int refill)
+{
+    int i;
+
+    if (p->cycles == 0) return;
+    rt_kprintf("%-*.*s %12u", RT_NAME_MAX, RT_NAME_MAX, p->name, (rt_uint32_t)(p->cycles / 1000));
+    pmu_show_ratio(p->cycles, total, 100, 6);
+    if (instr >= 0) pmu_show_ratio(p->count[instr], p->cycles, 1, 5);
+    else rt_kprintf(" %5s", "-");
+    if (access >= 0 && refill >= 0) pmu_show_ratio(p->count[refill], p->count[access], 100, 6);
+    else rt_kprintf(" %6s", "-");
+    for (i = 0; i < PMU_EVENT_NUM; i++) rt_kprintf(" %12u", (rt_uint32_t)(p->count[i] / 1000));
+    rt_kprintf("\n");
+}
+
+int perf(int argc, char **argv)
+{
+    rt_uint64_t total = 0;
+    int i, counter, instr, access, refill;
+
+    if (argc > 1 && !rt_strncmp(argv[1], "reset", 6))
+    {
+        pmu_reset();
+        return 0;
+    }
+    if (argc > 3 && !rt_strncmp(argv[1], "event", 6))
+    {
+        counter = atol(argv[2]);
+        if (counter < 0 || counter >= PMU_EVENT_NUM)
+        {
+            rt_kprintf("counter 0..%d\n", PMU_EVENT_NUM - 1);
+            return -1;
+        }
+        pmu_set_event(counter, strtoul(argv[3], RT_NULL, 16));
+        pmu_reset();
+        return 0;
+    }
+    if (argc > 1)
+    {
+        rt_kprintf("perf [reset | event <counter> <hex event>]\n");
+        return -1;
+    }
+
+    pmu_account();
+    for (i = 0; i < RT_PMU_THREAD_NUM; i++) total += pmu_thread[i].cycles;
+    total += pmu_other.cycles;
+
+    instr = pmu_counter_of(PMU_EV_INST_RETIRED);
+    access = pmu_counter_of(PMU_EV_L1D_ACCESS);
+    refill = pmu_counter_of(PMU_EV_L1D_REFILL);
+
+    pmu_show_header();
+    for (i = 0; i < RT_PMU_THREAD_NUM; i++) pmu_show(&pmu_thread[i], total, instr, access, refill);
+    pmu_show(&pmu_other, total, instr, access, refill);
+
+    return 0;
+}
+MSH_CMD_EXPORT(perf, cpu cycles ipc and cache misses per thread: [reset | event <counter> <hex event>]);
+#endif
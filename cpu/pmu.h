@@ -0,0 +1,59 @@
+/*
+ * File      : pmu.h
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2013-2014, RT-Thread Development Team
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rt-thread.org/license/LICENSE
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef __PMU_H__
+#define __PMU_H__
+
+#include <rtthread.h>
+
+/*
+ * Cortex-A7 performance monitor: the cycle counter and four event
+ * counters, all 32 bit and free running once rt_hw_pmu_init has run.
+ * Read them around a hot loop, or let the scheduler hook charge them
+ * to the running thread and look at msh perf.
+ */
+#define PMU_EVENT_NUM           4
+
+/* common architectural events, ARM ARM C12.8 */
+#define PMU_EV_L1I_REFILL       0x01
+#define PMU_EV_L1D_REFILL       0x03
+#define PMU_EV_L1D_ACCESS       0x04
+#define PMU_EV_INST_RETIRED     0x08
+#define PMU_EV_EXC_TAKEN        0x09
+#define PMU_EV_BR_MIS_PRED      0x10
+#define PMU_EV_CPU_CYCLES       0x11
+#define PMU_EV_BR_PRED          0x12
+#define PMU_EV_L2D_ACCESS       0x16
+#define PMU_EV_L2D_REFILL       0x17
+
+void rt_hw_pmu_init(void);
+
+/* counter 0..PMU_EVENT_NUM-1 counts event from now on */
+void pmu_set_event(int counter, rt_uint32_t event);
+rt_uint32_t pmu_get_event(int counter);
+rt_uint32_t pmu_get_counter(int counter);
+
+/* charge the counts since the last switch to the running thread */
+void pmu_account(void);
+/* give a thread's slot back, from the board's object detach hook */
+void pmu_thread_detach(rt_thread_t thread);
+
+rt_inline rt_uint32_t pmu_get_cycle(void)
+{
+    rt_uint32_t cycle;
+
+    __asm__ volatile ("mrc p15, 0, %0, c9, c13, 0" : "=r"(cycle));
+    return cycle;
+}
+
+#endif
@@ -17,8 +17,13 @@ rt_uint8_t *rt_hw_stack_init(void *tentry, void *parameter,
 {
 	rt_uint32_t *stk;
 
+	/* the frame vector_irq and rt_hw_context_switch leave, cpsr on top for rfe */
 	stk 	 = (rt_uint32_t*)stack_addr;
-	*(stk) 	 = (rt_uint32_t)tentry;			/* entry point */
+	if ((rt_uint32_t)tentry & 0x01)
+		*(stk) = SVCMODE | 0x20;			/* thumb mode */
+	else
+		*(stk) = SVCMODE;					/* arm mode   */
+	*(--stk) = (rt_uint32_t)tentry;		/* entry point */
 	*(--stk) = (rt_uint32_t)texit;			/* lr */
 	*(--stk) = 0;							/* r12 */
 	*(--stk) = 0;							/* r11 */
@@ -34,12 +39,6 @@ rt_uint8_t *rt_hw_stack_init(void *tentry, void *parameter,
 	*(--stk) = 0;							/* r1 */
 	*(--stk) = (rt_uint32_t)parameter;		/* r0 : argument */
 
-	/* cpsr */
-	if ((rt_uint32_t)tentry & 0x01)
-		*(--stk) = SVCMODE | 0x20;			/* thumb mode */
-	else
-		*(--stk) = SVCMODE;					/* arm mode   */
-
 	/* return task's current stack address */
 	return (rt_uint8_t *)stk;
 }
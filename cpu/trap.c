@@ -134,15 +134,20 @@ void rt_hw_trap_irq(void)
     void *param;
     rt_isr_handler_t isr_func;
     extern struct rt_irq_desc isr_table[];
+#ifdef RT_USING_INTERRUPT_INFO
+    extern rt_uint64_t rt_hw_interrupt_stat_enter(int vector, rt_uint64_t entry);
+    extern void rt_hw_interrupt_stat_leave(int vector, rt_uint64_t entry, rt_uint64_t time);
+    rt_uint64_t entry = get_ticks(), time;
+#endif
 
     // vectNum = RESERVED[31:13] | CPUID[12:10] | INTERRUPT_ID[9:0]
-    // send ack and get ID source
-    uint32_t vectNum = gic_read_irq_ack();
+    // send ack and get ID source, IRQs are group 1
+    uint32_t vectNum = gic_read_irq_ack_ns();
 
     // Check that INT_ID isn't 1023 or 1022 (spurious interrupt)
     if (vectNum & 0x0200)
     {
-        gic_write_end_of_irq(vectNum);  // send end of irq
+        gic_write_end_of_irq_ns(vectNum);  // send end of irq
     }
     else
     {
@@ -159,21 +164,50 @@ void rt_hw_trap_irq(void)
         isr_func = isr_table[irq].handler;
 #ifdef RT_USING_INTERRUPT_INFO
         isr_table[irq].counter++;
+        time = rt_hw_interrupt_stat_enter(irq, entry);
 #endif
         if (isr_func)
         {
             /* Interrupt for myself. */
             param = isr_table[irq].param;
+            /* The GIC now holds back this priority and any lower one until
+             * the end of irq, let the more urgent ones preempt the handler */
+            __asm__ volatile ("cpsie i" ::: "memory");
             /* turn to interrupt service routine */
             isr_func(irq, param);
+            __asm__ volatile ("cpsid i" ::: "memory");
         }
+#ifdef RT_USING_INTERRUPT_INFO
+        rt_hw_interrupt_stat_leave(irq, entry, time);
+#endif
 
         // Signal the end of the irq.
-        gic_write_end_of_irq(vectNum);
+        gic_write_end_of_irq_ns(vectNum);
     }
 }
 
+/*
+ * Interrupts unmasked with rt_hw_interrupt_umask_fiq end up here, in FIQ
+ * mode with IRQs masked and outside of rt_interrupt_enter/leave.
+ */
 void rt_hw_trap_fiq(void)
 {
-    /* TODO */
+    rt_isr_handler_t isr_func;
+    extern struct rt_irq_desc isr_table[];
+
+    // group 0 only, IAR never returns an IRQ here
+    uint32_t vectNum = gic_read_irq_ack();
+
+    if (!(vectNum & 0x0200))
+    {
+        unsigned irq = vectNum & 0x1FF;
+
+        isr_func = isr_table[irq].handler;
+#ifdef RT_USING_INTERRUPT_INFO
+        isr_table[irq].counter++;
+#endif
+        if (isr_func) isr_func(irq, isr_table[irq].param);
+    }
+
+    gic_write_end_of_irq(vectNum);
 }
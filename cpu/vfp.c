@@ -0,0 +1,216 @@
+/*
+ * File      : vfp.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2013-2014, RT-Thread Development Team
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rt-thread.org/license/LICENSE
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <board.h>
+
+/*
+ * Lazy VFP/NEON context. Only one thread's registers are live in the
+ * VFP bank, the owner. The context switch turns the unit on for the
+ * owner and off for everyone else, at no further cost. A thread that
+ * is not the owner traps on its first VFP instruction after a switch
+ * (vector_undef), and only then are the owner's registers saved and
+ * its own loaded. Threads that never touch floating point or NEON never
+ * pay for the register switch.
+ *
+ * The trap runs in UND mode and cannot allocate, so every thread gets
+ * its 264 byte save area when it is created, from the board's object
+ * attach hook in thread context. Areas of deleted threads go to a free
+ * list for the next one, the detach hook may run with interrupts off.
+ *
+ * The owner is kept as &thread->sp, what rt_hw_context_switch gets.
+ *
+ * This file is built with -mfloat-abi=soft (see SConscript) so the
+ * compiler itself never puts a VFP or NEON instruction in the trap.
+ */
+
+#define FPEXC_EN            (1 << 30)
+#define FPSCR_DEFAULT       0           /* round to nearest, no traps */
+
+struct vfp_context
+{
+    rt_uint64_t d[32];
+    rt_uint32_t fpscr;
+    rt_uint32_t *thread;                /* &thread->sp */
+    struct vfp_context *next;
+};
+
+static struct vfp_context *vfp_used, *vfp_free;
+rt_uint32_t *rt_vfp_owner;
+
+/* counters for fpu_bench */
+rt_uint32_t rt_vfp_traps, rt_vfp_switches;
+
+extern volatile rt_uint8_t rt_interrupt_nest;
+
+rt_inline void vfp_save(struct vfp_context *ctx)
+{
+    rt_uint64_t *d = ctx->d;
+    rt_uint32_t fpscr;
+
+    __asm__ volatile (
+        ".fpu    neon-vfpv4\n"
+        "vstmia  %1!, {d0-d15}\n"
+        "vstmia  %1!, {d16-d31}\n"
+        "vmrs    %0, fpscr\n"
+        : "=r"(fpscr), "+r"(d) : : "memory");
+    ctx->fpscr = fpscr;
+}
+
+rt_inline void vfp_restore(struct vfp_context *ctx)
+{
+    rt_uint64_t *d = ctx->d;
+
+    __asm__ volatile (
+        ".fpu    neon-vfpv4\n"
+        "vmsr    fpscr, %1\n"
+        "vldmia  %0!, {d0-d15}\n"
+        "vldmia  %0!, {d16-d31}\n"
+        : "+r"(d) : "r"(ctx->fpscr) : "memory");
+}
+
+rt_inline void vfp_set_fpexc(rt_uint32_t fpexc)
+{
+    __asm__ volatile (
+        ".fpu    neon-vfpv4\n"
+        "vmsr    fpexc, %0\n"
+        : : "r"(fpexc));
+}
+
+/* call with interrupts off */
+static struct vfp_context *vfp_find(rt_uint32_t *thread)
+{
+    struct vfp_context *ctx;
+
+    for (ctx = vfp_used; ctx != RT_NULL; ctx = ctx->next)
+        if (ctx->thread == thread) return ctx;
+    return RT_NULL;
+}
+
+/*
+ * Where rt_hw_vfp_trap sends a thread that has no save area, in the
+ * thread's own mode and on its own stack, with room for rt_kprintf.
+ */
+static void vfp_no_context(void)
+{
+    rt_kprintf("vfp: thread %.*s has no save area, out of memory at its creation\n",
+        RT_NAME_MAX, rt_thread_self()->name);
+    rt_hw_cpu_shutdown();
+}
+
+/*
+ * Called from vector_undef with IRQs masked while FPEXC.EN is clear,
+ * the faulting instruction is retried on return. A genuinely undefined
+ * one traps again with the unit on and goes to rt_hw_trap_undef.
+ *
+ * This runs on the small UND stack: nothing here may print. When the
+ * thread cannot have the unit, the return goes to the address returned
+ * instead of the faulting instruction, 0 otherwise.
+ */
+rt_uint32_t rt_hw_vfp_trap(void)
+{
+    struct vfp_context *ctx;
+    rt_uint32_t *self;
+
+    vfp_set_fpexc(FPEXC_EN);
+    rt_vfp_traps++;
+
+    /* an interrupt handler: park the owner, vector_irq turns the unit off again on exit */
+    if (rt_interrupt_nest)
+    {
+        if (rt_vfp_owner) vfp_save(vfp_find(rt_vfp_owner));
+        rt_vfp_owner = RT_NULL;
+        return 0;
+    }
+
+    self = (rt_uint32_t *)&rt_thread_self()->sp;
+    if (rt_vfp_owner == self) return 0;
+
+    ctx = vfp_find(self);
+    if (ctx == RT_NULL)
+    {
+        /* out of heap when the thread was created, the owner keeps the unit */
+        vfp_set_fpexc(0);
+        return (rt_uint32_t)vfp_no_context;
+    }
+    if (rt_vfp_owner) vfp_save(vfp_find(rt_vfp_owner));
+    rt_vfp_switches++;
+    vfp_restore(ctx);
+    rt_vfp_owner = self;
+    return 0;
+}
+
+/* a new thread starts from clean registers */
+void rt_hw_vfp_thread_attach(rt_thread_t thread)
+{
+    struct vfp_context *ctx;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    ctx = vfp_free;
+    if (ctx) vfp_free = ctx->next;
+    rt_hw_interrupt_enable(level);
+
+    if (ctx == RT_NULL) ctx = rt_malloc(sizeof(struct vfp_context));
+    if (ctx == RT_NULL) return;     /* rt_hw_vfp_trap tells, should it ever use the unit */
+
+    rt_memset(ctx->d, 0, sizeof(ctx->d));
+    ctx->fpscr = FPSCR_DEFAULT;
+    ctx->thread = (rt_uint32_t *)&thread->sp;
+
+    level = rt_hw_interrupt_disable();
+    ctx->next = vfp_used;
+    vfp_used = ctx;
+    rt_hw_interrupt_enable(level);
+}
+
+/* a deleted or detached thread gives its save area back */
+void rt_hw_vfp_thread_detach(rt_thread_t thread)
+{
+    struct vfp_context *ctx, **p;
+    rt_uint32_t *sp = (rt_uint32_t *)&thread->sp;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (rt_vfp_owner == sp) rt_vfp_owner = RT_NULL;
+    for (p = &vfp_used; (ctx = *p) != RT_NULL; p = &ctx->next)
+    {
+        if (ctx->thread != sp) continue;
+        *p = ctx->next;
+        ctx->next = vfp_free;
+        vfp_free = ctx;
+        break;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+/* before the scheduler starts, the boot code may use the unit freely */
+void rt_hw_vfp_init(void)
+{
+    rt_hw_cpu_vfp_enable();
+    rt_vfp_owner = RT_NULL;
+}
+
+/* hand the registers back the way switching away and back again would */
+void rt_hw_vfp_release(void)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+
+    if (rt_vfp_owner) vfp_save(vfp_find(rt_vfp_owner));
+    rt_vfp_owner = RT_NULL;
+    vfp_set_fpexc(0);
+    rt_hw_interrupt_enable(level);
+}
+
+
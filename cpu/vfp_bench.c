@@ -0,0 +1,141 @@
+/*
+ * File      : vfp_bench.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2013-2014, RT-Thread Development Team
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rt-thread.org/license/LICENSE
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <board.h>
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#include <stdlib.h>
+
+/*
+ * The hard float half of fpu_bench. vfp.c is built without the VFP, so
+ * this lives in a file of its own that is built like the rest of the
+ * tree.
+ */
+
+/* cpu/vfp.c */
+extern rt_uint32_t rt_vfp_traps, rt_vfp_switches;
+
+/* libgcc soft float, what every float operation was before */
+extern float __aeabi_fadd(float a, float b);
+extern float __aeabi_fmul(float a, float b);
+extern double __aeabi_dadd(double a, double b);
+extern double __aeabi_dmul(double a, double b);
+
+#define BENCH_SAMPLES   1024
+
+/* direct form 1 biquad low pass, the shape of our filters */
+static const float bq_b0 = 0.0675f, bq_b1 = 0.1349f, bq_b2 = 0.0675f;
+static const float bq_a1 = 1.1430f, bq_a2 = -0.4128f;
+
+static float bench_in[BENCH_SAMPLES], bench_out[BENCH_SAMPLES];
+
+static void biquad_hard(const float *in, float *out, int n)
+{
+    float x1 = 0, x2 = 0, y1 = 0, y2 = 0, y;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        y = bq_b0 * in[i] + bq_b1 * x1 + bq_b2 * x2 + bq_a1 * y1 + bq_a2 * y2;
+        x2 = x1; x1 = in[i];
+        y2 = y1; y1 = y;
+        out[i] = y;
+    }
+}
+
+static void biquad_soft(const float *in, float *out, int n)
+{
+    float x1 = 0, x2 = 0, y1 = 0, y2 = 0, y;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        y = __aeabi_fmul(bq_b0, in[i]);
+        y = __aeabi_fadd(y, __aeabi_fmul(bq_b1, x1));
+        y = __aeabi_fadd(y, __aeabi_fmul(bq_b2, x2));
+        y = __aeabi_fadd(y, __aeabi_fmul(bq_a1, y1));
+        y = __aeabi_fadd(y, __aeabi_fmul(bq_a2, y2));
+        x2 = x1; x1 = in[i];
+        y2 = y1; y1 = y;
+        out[i] = y;
+    }
+}
+
+static double dot_hard(const float *a, const float *b, int n)
+{
+    double sum = 0;
+    int i;
+
+    for (i = 0; i < n; i++) sum += (double)a[i] * b[i];
+    return sum;
+}
+
+static double dot_soft(const float *a, const float *b, int n)
+{
+    double sum = 0;
+    int i;
+
+    for (i = 0; i < n; i++) sum = __aeabi_dadd(sum, __aeabi_dmul(a[i], b[i]));
+    return sum;
+}
+
+/* soft float library against the VFP, and what the lazy switch costs */
+int fpu_bench(int argc, char **argv)
+{
+    rt_uint64_t t0, t_soft, t_hard;
+    rt_uint32_t traps;
+    volatile double sink;
+    int i, rounds = 100;
+
+    if (argc > 1) rounds = atol(argv[1]);
+    for (i = 0; i < BENCH_SAMPLES; i++) bench_in[i] = (float)((i * 37) % 101) - 50.0f;
+
+    t0 = get_ticks();
+    for (i = 0; i < rounds; i++) biquad_soft(bench_in, bench_out, BENCH_SAMPLES);
+    t_soft = get_ticks() - t0;
+    t0 = get_ticks();
+    for (i = 0; i < rounds; i++) biquad_hard(bench_in, bench_out, BENCH_SAMPLES);
+    t_hard = get_ticks() - t0;
+    rt_kprintf("biquad float  %d samples: soft %6d us, vfp %6d us\n", rounds * BENCH_SAMPLES,
+        (int)(t_soft / 24), (int)(t_hard / 24));
+
+    t0 = get_ticks();
+    for (i = 0; i < rounds; i++) sink = dot_soft(bench_in, bench_out, BENCH_SAMPLES);
+    t_soft = get_ticks() - t0;
+    t0 = get_ticks();
+    for (i = 0; i < rounds; i++) sink = dot_hard(bench_in, bench_out, BENCH_SAMPLES);
+    t_hard = get_ticks() - t0;
+    rt_kprintf("dot double    %d samples: soft %6d us, vfp %6d us\n", rounds * BENCH_SAMPLES,
+        (int)(t_soft / 24), (int)(t_hard / 24));
+    (void)sink;
+
+    /* a save, a trap and a restore, what a switch between two fpu users costs */
+    traps = rt_vfp_traps;
+    t0 = get_ticks();
+    for (i = 0; i < rounds; i++)
+    {
+        rt_hw_vfp_release();
+        sink = dot_hard(bench_in, bench_out, 1);
+    }
+    t_hard = get_ticks() - t0;
+    rt_kprintf("lazy switch   %d traps, %d ns each\n", rt_vfp_traps - traps,
+        (int)(t_hard * 125 / 3 / rounds));
+    rt_kprintf("since boot    %d traps, %d register bank switches\n", rt_vfp_traps, rt_vfp_switches);
+
+    return 0;
+}
+MSH_CMD_EXPORT(fpu_bench, soft float against vfp and the lazy fpu switch cost: [rounds]);
+#endif
@@ -27,21 +27,105 @@
 
 #include "board.h"
 #include "interrupt.h"
+#include "pmu.h"
 #include "drivers/watchdog.h"
 
 int ctrlc(void) { return 0; }
 extern int tick_timer_ack(void);
+
+#ifdef RT_USING_TICKLESS
+extern void tick_timer_oneshot(ulong counts);
+extern void tick_timer_periodic(ulong first);
+
+/* clocksource counts per os tick */
+#define TICK_COUNTS         (24000000 / RT_TICK_PER_SECOND)
+/* longest idle sleep, a timer interval holds 178 s */
+#define TICKLESS_MAX_TICKS  (RT_TICK_PER_SECOND * 10)
+
+/* clocksource count (low 32 bits) of the last tick accounted for */
+static rt_uint32_t tick_last;
+
+/*
+ * The tick follows the clocksource, so however long idle slept, the
+ * interrupt that ends it accounts for every tick that passed. Timers
+ * and time slices run once for the lot.
+ */
+static void clock_irq(int vector, void *param)
+{
+    rt_uint32_t n;
+
+    tick_timer_ack();
+    n = ((rt_uint32_t)get_ticks() - tick_last) / TICK_COUNTS;
+    if (n == 0) return;
+    tick_last += n * TICK_COUNTS;
+    if (n > 1) rt_tick_set(rt_tick_get() + n - 1);
+    pmu_account();
+    rt_tick_increase();
+}
+
+/*
+ * Nothing to run: sleep in wfi until the next timer is due instead of
+ * taking an interrupt every tick. Interrupts stay off across wfi, it
+ * still wakes on one pending and the handler runs once they are on.
+ */
+static void tickless_idle(void)
+{
+    rt_base_t level;
+    rt_tick_t sleep, next;
+    rt_uint32_t due = 0;
+
+    level = rt_hw_interrupt_disable();
+    next = rt_timer_next_timeout_tick();
+    sleep = next == RT_TICK_MAX ? TICKLESS_MAX_TICKS : next - rt_tick_get();
+    if (sleep > 1 && sleep < RT_TICK_MAX / 2)
+    {
+        if (sleep > TICKLESS_MAX_TICKS) sleep = TICKLESS_MAX_TICKS;
+        /* counts to the tick boundary the timer is due at, none if a tick is overdue */
+        due = tick_last + sleep * TICK_COUNTS - (rt_uint32_t)get_ticks();
+        if ((rt_int32_t)due <= 0) due = 0;
+    }
+    if (due)
+    {
+        tick_timer_oneshot(due);
+        asm volatile ("wfi");
+        /* resume on the tick_last grid, clock_irq counts whole ticks from it */
+        tick_timer_periodic(TICK_COUNTS - ((rt_uint32_t)get_ticks() - tick_last) % TICK_COUNTS);
+    }
+    else
+        asm volatile ("wfi");
+    rt_hw_interrupt_enable(level);
+}
+#else
 static void clock_irq(int vector, void *param)
 {
     tick_timer_ack();
+    /* keeps the 32 bit counters from wrapping under a thread that never switches */
+    pmu_account();
     rt_tick_increase();
 }
 
+#ifdef RT_USING_INTERRUPT_INFO
+/* the periodic timer reloaded when it raised the tick */
+static uint64_t clock_raised(int vector)
+{
+    return get_ticks() - tick_read_timer();
+}
+#endif
+#endif
+
 extern int tick_timer_init(int tick);
 void rt_hw_tick_init(void)
 {
     tick_timer_init(RT_TICK_PER_SECOND);
+#ifdef RT_USING_TICKLESS
+    tick_last = (rt_uint32_t)get_ticks();
+    rt_thread_idle_sethook(tickless_idle);
+#endif
     rt_hw_interrupt_install(50, clock_irq, RT_NULL, "tick");
+    rt_hw_interrupt_set_priority(50, IRQ_PRIO_TICK);
+#if defined(RT_USING_INTERRUPT_INFO) && !defined(RT_USING_TICKLESS)
+    rt_hw_interrupt_set_raised(50, clock_raised);
+#endif
     rt_hw_interrupt_umask(50);
 }
 
@@ -58,10 +142,34 @@ int sun4i_pwm_using(void)
     return 0;
 };
 
+#ifndef RT_USING_HOOK
+#error "the vfp save areas come from the object hooks, enable RT_USING_HOOK"
+#endif
+
+/* the one pair of object hooks, for everything that keeps state per thread */
+static void board_object_attach(struct rt_object *object)
+{
+    if (rt_object_get_type(object) != RT_Object_Class_Thread) return;
+    rt_hw_vfp_thread_attach((rt_thread_t)object);
+}
+
+static void board_object_detach(struct rt_object *object)
+{
+    if (rt_object_get_type(object) != RT_Object_Class_Thread) return;
+    rt_hw_vfp_thread_detach((rt_thread_t)object);
+    pmu_thread_detach((rt_thread_t)object);
+}
+
 void rt_hw_board_init(void)
 {
     // init mmu
     rt_hw_mmu_init();
+    // vfp/neon on, threads get it lazily once the scheduler runs
+    rt_hw_vfp_init();
+    // cycle and event counters, charged to threads on every switch
+    rt_hw_pmu_init();
+    rt_object_attach_sethook(board_object_attach);
+    rt_object_detach_sethook(board_object_detach);
     // init interrupt
     rt_hw_interrupt_init();
     
@@ -108,5 +216,82 @@ int cmd_reboot(int argc, char** argv)
 }
 
 FINSH_FUNCTION_EXPORT_ALIAS(cmd_reboot, __cmd_reboot, Reboot With WDT.)
+
+/* clocksource self-test: monotonicity, call overhead and delay accuracy */
+#define TIMER_TEST_LOOPS    10000
+#define TIMER_TICKS_TO_NS(t)    ((t) * 125 / 3)
+
+#define TIMER_TEST_COST(name, call) \
+    do { \
+        level = rt_hw_interrupt_disable(); \
+        t0 = get_ticks(); \
+        for (i = 0; i < TIMER_TEST_LOOPS; i++) sink = call; \
+        t1 = get_ticks(); \
+        rt_hw_interrupt_enable(level); \
+        rt_kprintf("%-20s %d ns/call\n", name, \
+            (int)(TIMER_TICKS_TO_NS(t1 - t0) / TIMER_TEST_LOOPS)); \
+    } while (0)
+
+int timer_test(int argc, char** argv)
+{
+    static const int delays[] = {1, 10, 100, 1000};
+    uint64_t t0, t1, prev, now, step = ~0ull;
+    volatile uint64_t sink;
+    rt_base_t level;
+    rt_tick_t tick;
+    int i, backwards = 0, errors = 0;
+    int err_ns, expected_us, diff_us;
+
+    /* consecutive reads never go back, and how fine they step */
+    level = rt_hw_interrupt_disable();
+    prev = get_ticks();
+    for (i = 0; i < TIMER_TEST_LOOPS; i++)
+    {
+        now = get_ticks();
+        if (now < prev) backwards++;
+        else if (now > prev && now - prev < step) step = now - prev;
+        prev = now;
+    }
+    rt_hw_interrupt_enable(level);
+    rt_kprintf("monotonic            %s, step %d ns\n", backwards ? "FAIL" : "ok",
+        (int)TIMER_TICKS_TO_NS(step));
+    if (backwards) errors++;
+
+    TIMER_TEST_COST("get_ticks", get_ticks());
+    TIMER_TEST_COST("timer_get_ns", timer_get_ns());
+    TIMER_TEST_COST("timer_get_boot_us", timer_get_boot_us());
+    TIMER_TEST_COST("timer_get_us", timer_get_us());
+    (void)sink;
+
+    /* udelay may run long by the call overhead, never short */
+    for (i = 0; i < sizeof(delays) / sizeof(delays[0]); i++)
+    {
+        level = rt_hw_interrupt_disable();
+        t0 = timer_get_ns();
+        udelay(delays[i]);
+        t1 = timer_get_ns();
+        rt_hw_interrupt_enable(level);
+        err_ns = (int)(t1 - t0) - delays[i] * 1000;
+        rt_kprintf("udelay(%4d)         %+d ns %s\n", delays[i], err_ns, err_ns < 0 ? "FAIL" : "ok");
+        if (err_ns < 0) errors++;
+    }
+
+    /* against the os tick, counted by sunxi timer 0 */
+    rt_thread_delay(1);
+    tick = rt_tick_get();
+    t0 = timer_get_boot_us();
+    rt_thread_delay(RT_TICK_PER_SECOND);
+    t1 = timer_get_boot_us();
+    tick = rt_tick_get() - tick;
+    expected_us = tick * (1000000 / RT_TICK_PER_SECOND);
+    diff_us = (int)(t1 - t0) - expected_us;
+    rt_kprintf("vs tick              %d ticks, %d us, %+d us %s\n", tick, (int)(t1 - t0), diff_us,
+        diff_us > 1000000 / RT_TICK_PER_SECOND || -diff_us > 1000000 / RT_TICK_PER_SECOND ? "FAIL" : "ok");
+    if (diff_us > 1000000 / RT_TICK_PER_SECOND || -diff_us > 1000000 / RT_TICK_PER_SECOND) errors++;
+
+    rt_kprintf("%s\n", errors ? "FAILED" : "passed");
+    return errors;
+}
+MSH_CMD_EXPORT(timer_test, clocksource accuracy and call overhead self-test);
 #endif //RT_USING_FINSH
 
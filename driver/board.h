@@ -31,15 +31,66 @@ extern unsigned char __bss_start;
 extern unsigned char __bss_end;
 
 #define RT_HW_HEAP_BEGIN    (void*)&__bss_end
-#define RT_HW_HEAP_END      (void*)0x43800000
+#define RT_HW_HEAP_END      (void*)0x44000000
 
 void rt_hw_board_init(void);
 void rt_hw_mmu_init(void);
+void rt_hw_cpu_vfp_enable(void);
+/* lazy vfp/neon context switch, cpu/vfp.c */
+void rt_hw_vfp_init(void);
+void rt_hw_vfp_release(void);
+/* a thread's save area, from the object hooks in board.c */
+void rt_hw_vfp_thread_attach(rt_thread_t thread);
+void rt_hw_vfp_thread_detach(rt_thread_t thread);
 
 void udelay(unsigned long usec);
 void mdelay(unsigned long msec);
 ulong tick_read_timer(void);
 
+/* free-running 24 MHz clocksource (CNTPCT) and time since boot */
+uint64_t get_ticks(void);
+uint64_t timer_get_boot_us(void);
+uint64_t timer_get_ns(void);
+unsigned long timer_get_us(void);
+
+/*
+ * GIC priorities, lower is more urgent. A handler runs with IRQs unmasked
+ * and is preempted by any interrupt of a more urgent level, so keep the
+ * slow ones (network, storage) low. Set with rt_hw_interrupt_set_priority
+ * before rt_hw_interrupt_umask, the default is IRQ_PRIO_DEFAULT.
+ */
+#define IRQ_PRIO_FIQ        0x00
+#define IRQ_PRIO_HRTIMER    0x20
+#define IRQ_PRIO_TICK       0x40
+#define IRQ_PRIO_UART       0x60
+#define IRQ_PRIO_DISPLAY    0x80
+#define IRQ_PRIO_DEFAULT    0xa0
+#define IRQ_PRIO_BULK       0xc0
+
+void rt_hw_interrupt_set_priority(int vector, unsigned int priority);
+unsigned int rt_hw_interrupt_get_priority(int vector);
+
+/*
+ * With RT_USING_INTERRUPT_INFO list_irq shows handler time and, for the
+ * vectors with a probe, the latency from the source raising the interrupt.
+ * The probe runs in the interrupt before the handler and returns the
+ * get_ticks() count it was raised at, or 0 if it cannot tell.
+ */
+typedef uint64_t (*rt_irq_raised_t)(int vector);
+void rt_hw_interrupt_set_raised(int vector, rt_irq_raised_t raised);
+
+/*
+ * FIQ fast path for one or two hard real-time sources. Install the handler
+ * with rt_hw_interrupt_install and unmask with rt_hw_interrupt_umask_fiq.
+ * It runs in FIQ mode on banked registers, preempts everything including
+ * rt_hw_interrupt_disable sections, and must not call RT-Thread services
+ * or use floating point or neon, whose registers it would corrupt; hand
+ * data to threads through memory and a normal interrupt or poll. Put it
+ * in a file listed as soft float in cpu/SConscript, -ftree-vectorize
+ * turns plain loops into neon elsewhere.
+ */
+void rt_hw_interrupt_umask_fiq(int vector);
+
 /* GPIO bank sizes */
 #define SUNXI_GPIO_A_NR		32
 #define SUNXI_GPIO_B_NR		32
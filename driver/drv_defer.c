@@ -0,0 +1,271 @@
+/*
+ * File      : drv_defer.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+
+#include "board.h"
+#include "drv_defer.h"
+
+#define DEFER_STACK_SIZE    2048
+
+struct defer_queue
+{
+    const char *name;
+    rt_uint8_t priority;
+
+    /*
+     * Submits push onto head with ldrex/strex, the worker takes the whole
+     * list at once. With a single consumer that only ever empties it there
+     * is no ABA problem and nothing needs interrupts masked.
+     */
+    struct defer_work * volatile head;
+    struct rt_semaphore sem;
+
+    /* submit to run latency in clocksource counts, written by the worker */
+    rt_uint32_t runs;
+    rt_uint32_t lat_min, lat_max;
+    rt_uint64_t lat_sum;
+    volatile rt_uint32_t coalesced;
+};
+
+static struct defer_queue _queue[DEFER_PRIO_NUM] =
+{
+    {"defer_hi", 4},
+    {"defer",    12},
+    {"defer_lo", RT_THREAD_PRIORITY_MAX - 4},
+};
+
+static void _defer_stat_reset(struct defer_queue *q)
+{
+    q->runs = 0;
+    q->lat_min = ~0u;
+    q->lat_max = 0;
+    q->lat_sum = 0;
+    q->coalesced = 0;
+}
+
+int defer_work_submit(struct defer_work *work)
+{
+    struct defer_queue *q = &_queue[work->prio];
+    struct defer_work *head;
+
+    if (!__sync_bool_compare_and_swap(&work->pending, 0, 1))
+    {
+        __sync_fetch_and_add(&q->coalesced, 1);
+        return 1;
+    }
+
+    work->submitted = get_ticks();
+    do
+    {
+        head = q->head;
+        work->next = head;
+    } while (!__sync_bool_compare_and_swap(&q->head, head, work));
+
+    /* the worker drains until empty, only the first submit has to wake it */
+    if (head == RT_NULL) rt_sem_release(&q->sem);
+    return 0;
+}
+
+static void _defer_timeout(void *parameter)
+{
+    defer_work_submit((struct defer_work *)parameter);
+}
+
+void defer_work_init(struct defer_work *work, defer_func_t func, void *param, int prio)
+{
+    RT_ASSERT(prio >= 0 && prio < DEFER_PRIO_NUM);
+
+    work->func = func;
+    work->param = param;
+    work->prio = prio;
+    work->next = RT_NULL;
+    work->pending = 0;
+    rt_timer_init(&work->timer, "defer", _defer_timeout, work, 0, RT_TIMER_FLAG_ONE_SHOT);
+}
+
+void defer_work_submit_delayed(struct defer_work *work, rt_tick_t ticks)
+{
+    if (ticks == 0)
+    {
+        defer_work_submit(work);
+        return;
+    }
+    rt_timer_stop(&work->timer);
+    rt_timer_control(&work->timer, RT_TIMER_CTRL_SET_TIME, &ticks);
+    rt_timer_start(&work->timer);
+}
+
+void defer_work_cancel(struct defer_work *work)
+{
+    rt_timer_stop(&work->timer);
+}
+
+static void _defer_thread_entry(void *parameter)
+{
+    struct defer_queue *q = (struct defer_queue *)parameter;
+    struct defer_work *list, *work, *prev;
+    rt_uint32_t lat;
+
+    for (;;)
+    {
+        rt_sem_take(&q->sem, RT_WAITING_FOREVER);
+
+        while ((list = __sync_lock_test_and_set(&q->head, RT_NULL)) != RT_NULL)
+        {
+            /* pushed newest first, run them in submit order */
+            for (prev = RT_NULL; list; list = work)
+            {
+                work = list->next;
+                list->next = prev;
+                prev = list;
+            }
+
+            for (list = prev; list; )
+            {
+                work = list;
+                list = work->next;
+
+                lat = (rt_uint32_t)(get_ticks() - work->submitted);
+                if (lat < q->lat_min) q->lat_min = lat;
+                if (lat > q->lat_max) q->lat_max = lat;
+                q->lat_sum += lat;
+                q->runs++;
+
+                /* a submit from here on queues it again */
+                __sync_synchronize();
+                work->pending = 0;
+                work->func(work, work->param);
+            }
+        }
+    }
+}
+
+int rt_hw_defer_init(void)
+{
+    rt_thread_t tid;
+    int i;
+
+    for (i = 0; i < DEFER_PRIO_NUM; i++)
+    {
+        _defer_stat_reset(&_queue[i]);
+        rt_sem_init(&_queue[i].sem, _queue[i].name, 0, RT_IPC_FLAG_FIFO);
+        tid = rt_thread_create(_queue[i].name, _defer_thread_entry, &_queue[i],
+            DEFER_STACK_SIZE, _queue[i].priority, 10);
+        if (tid == RT_NULL) return -1;
+        rt_thread_startup(tid);
+    }
+
+    return 0;
+}
+INIT_PREV_EXPORT(rt_hw_defer_init);
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#include <stdlib.h>
+#include "gic.h"
+
+#define COUNTS_NS(c)    ((rt_uint32_t)((rt_uint64_t)(c) * 125 / 3))
+
+static void _defer_stat_show(void)
+{
+    struct defer_queue *q;
+    int i;
+
+    rt_kprintf("queue     prio     runs coalesced  lat min  lat avg  lat max ns\n");
+    for (i = 0; i < DEFER_PRIO_NUM; i++)
+    {
+        q = &_queue[i];
+        rt_kprintf("%-8s %5d %8d %9d %8d %8d %8d\n", q->name, q->priority, q->runs, q->coalesced,
+            q->runs ? COUNTS_NS(q->lat_min) : 0,
+            q->runs ? COUNTS_NS(q->lat_sum / q->runs) : 0,
+            COUNTS_NS(q->lat_max));
+    }
+}
+
+int defer_stat(int argc, char **argv)
+{
+    int i;
+
+    if (argc > 1 && !rt_strncmp(argv[1], "reset", 6))
+    {
+        for (i = 0; i < DEFER_PRIO_NUM; i++) _defer_stat_reset(&_queue[i]);
+        return 0;
+    }
+    _defer_stat_show();
+    return 0;
+}
+MSH_CMD_EXPORT(defer_stat, deferred work latency per queue: [reset]);
+
+/* software interrupt this cpu raises for itself in defer_bench */
+#define DEFER_BENCH_SGI     4
+
+static struct defer_work _bench_work;
+static struct rt_semaphore _bench_done;
+
+static void _bench_isr(int vector, void *param)
+{
+    defer_work_submit(&_bench_work);
+}
+
+static void _bench_func(struct defer_work *work, void *param)
+{
+    rt_sem_release(&_bench_done);
+}
+
+/* interrupt to work function latency of every queue */
+int defer_bench(int argc, char **argv)
+{
+    int i, prio, count = 1000;
+
+    if (argc > 1) count = atol(argv[1]);
+
+    rt_sem_init(&_bench_done, "dbench", 0, RT_IPC_FLAG_FIFO);
+    rt_hw_interrupt_install(DEFER_BENCH_SGI, _bench_isr, RT_NULL, "dbench");
+    rt_hw_interrupt_umask(DEFER_BENCH_SGI);
+
+    for (prio = 0; prio < DEFER_PRIO_NUM; prio++)
+    {
+        defer_work_init(&_bench_work, _bench_func, RT_NULL, prio);
+        _defer_stat_reset(&_queue[prio]);
+        for (i = 0; i < count; i++)
+        {
+            gic_send_sgi(DEFER_BENCH_SGI, 0, kGicSgiFilter_OnlyThisCPU);
+            if (rt_sem_take(&_bench_done, RT_TICK_PER_SECOND) != RT_EOK)
+            {
+                rt_kprintf("%s: work did not run\n", _queue[prio].name);
+                break;
+            }
+        }
+        rt_timer_detach(&_bench_work.timer);
+    }
+
+    rt_hw_interrupt_mask(DEFER_BENCH_SGI);
+    rt_sem_detach(&_bench_done);
+    _defer_stat_show();
+
+    return 0;
+}
+MSH_CMD_EXPORT(defer_bench, interrupt to deferred work latency: [count]);
+#endif
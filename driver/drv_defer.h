@@ -0,0 +1,66 @@
+/*
+ * File      : drv_defer.h
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef _DRV_DEFER_H_
+#define _DRV_DEFER_H_
+
+#include <rtthread.h>
+
+/*
+ * Deferred work for drivers: the interrupt handler only acks the device
+ * and submits a work item, its function runs later in the worker thread
+ * of the priority it was initialised with, where it may block. Submitting
+ * never blocks or masks interrupts and is safe from any context, nested
+ * interrupts included. A work item already waiting is not queued twice,
+ * the submits coalesce into one run; one submitted while it runs is run
+ * again afterwards. Delayed submits replace a periodic polling thread.
+ */
+#define DEFER_HIGH          0
+#define DEFER_NORMAL        1
+#define DEFER_LOW           2
+#define DEFER_PRIO_NUM      3
+
+struct defer_work;
+typedef void (*defer_func_t)(struct defer_work *work, void *param);
+
+struct defer_work
+{
+    defer_func_t func;
+    void *param;
+    int prio;
+
+    /* private */
+    struct defer_work *next;
+    volatile int pending;
+    rt_uint64_t submitted;      /* clocksource count of the submit that queued it */
+    struct rt_timer timer;      /* delayed submit */
+};
+
+void defer_work_init(struct defer_work *work, defer_func_t func, void *param, int prio);
+/* returns 1 when the work was already waiting and the submit coalesced */
+int defer_work_submit(struct defer_work *work);
+void defer_work_submit_delayed(struct defer_work *work, rt_tick_t ticks);
+/* stops a delayed submit, work already queued still runs */
+void defer_work_cancel(struct defer_work *work);
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "board.h"
 #include "interrupt.h"
+#include "drv_defer.h"
 #include <netif/ethernetif.h>
 #include <lwipopts.h>
 
@@ -203,35 +204,34 @@ struct pbuf *_emac_rx(rt_device_t dev)
 }
 
 extern int miiphy_link(const char *devname, unsigned char addr);
-static void phy_thread_entry(void *parameter)
+/* link poll once a second on the low priority work queue */
+static struct defer_work phy_work;
+static int phy_link;
+
+static void phy_work_func(struct defer_work *work, void *parameter)
 {
     struct eth_device *dev = (struct eth_device *)parameter;
     struct emac_device *emac = _EMAC_DEVICE(dev);
     RT_ASSERT(emac != RT_NULL);
 
-    // wait for init to complete
-    int initlink = 0;
-    rt_thread_delay(RT_TICK_PER_SECOND);
-    while (1)
-    {
-        /* check link status */
-        int link = miiphy_link("emac", PHY_ADDR);
-        if (link != initlink){
-            rt_kprintf("emac link status:%d\n", link);
-            eth_device_linkchange(dev, link);
-            initlink = link;
-        }
-        /* dma buf error, restat emac */
-        int status = __REG(emac->base + EMAC_INT_STA);
-        if (status & 0x40){
-            __REG(emac->base + EMAC_INT_STA) = 0xffff;
-            rt_kprintf("emac dma err status:%x\n", status);
-            eth_device_linkchange(dev, 0);
-            _emac_init(&dev->parent);
-            rt_thread_delay(RT_TICK_PER_SECOND);
-        }
-        rt_thread_delay(RT_TICK_PER_SECOND);
+    /* check link status */
+    int link = miiphy_link("emac", PHY_ADDR);
+    if (link != phy_link){
+        rt_kprintf("emac link status:%d\n", link);
+        eth_device_linkchange(dev, link);
+        phy_link = link;
+    }
+    /* dma buf error, restat emac */
+    int status = __REG(emac->base + EMAC_INT_STA);
+    if (status & 0x40){
+        __REG(emac->base + EMAC_INT_STA) = 0xffff;
+        rt_kprintf("emac dma err status:%x\n", status);
+        eth_device_linkchange(dev, 0);
+        _emac_init(&dev->parent);
+        defer_work_submit_delayed(work, 2 * RT_TICK_PER_SECOND);
+        return;
     }
+    defer_work_submit_delayed(work, RT_TICK_PER_SECOND);
 }
 
 extern int sun8i_emac_eth_probe(const char* name, uint32_t sysctl, uint32_t reg, uint8_t addr, void **priv);
@@ -267,13 +267,12 @@ int rt_hw_eth_init(void)
     /* register ETH device */
     eth_device_init(&(_emac.parent), "e0");
     rt_hw_interrupt_install(114, _enet_isr, &(_emac.parent), "emac");
+    rt_hw_interrupt_set_priority(114, IRQ_PRIO_BULK);
     rt_hw_interrupt_umask(114);
 
-    /* check phy link status */
-    rt_thread_t tid = rt_thread_create("phy", phy_thread_entry,
-                           &(_emac.parent),
-                           512, RT_THREAD_PRIORITY_MAX - 4, 20);
-    rt_thread_startup(tid);
+    /* check phy link status, once init has completed */
+    defer_work_init(&phy_work, phy_work_func, &(_emac.parent), DEFER_LOW);
+    defer_work_submit_delayed(&phy_work, RT_TICK_PER_SECOND);
 
 	return 0;
 }
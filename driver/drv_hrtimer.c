@@ -0,0 +1,392 @@
+/*
+ * File      : drv_hrtimer.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+
+#include "board.h"
+#include "interrupt.h"
+#include "drv_hrtimer.h"
+
+#ifndef HRTIMER_MAX
+#define HRTIMER_MAX         16
+#endif
+#define HRTIMER_IRQ         51      /* sunxi timer 1 */
+/* shortest one-shot interval, programming takes about as long */
+#define HRTIMER_SLACK       48      /* 2 us */
+/* longest one-shot interval, the timer holds 32 bits */
+#define HRTIMER_MAX_COUNTS  0xf0000000u
+
+extern void hr_timer_init(void);
+extern void hr_timer_oneshot(ulong counts);
+extern void hr_timer_stop(void);
+extern void hr_timer_ack(void);
+
+/* everything below is only touched with interrupts disabled or from the isr */
+static struct hrtimer *_heap[HRTIMER_MAX];
+static int _heap_num;
+static struct hrtimer *_queue_head, *_queue_tail;
+static struct rt_semaphore _queue_sem;
+/* count timer 1 is due to fire at, 0 while stopped */
+static rt_uint64_t _armed;
+
+static void _heap_swap(int a, int b)
+{
+    struct hrtimer *t = _heap[a];
+
+    _heap[a] = _heap[b];
+    _heap[b] = t;
+    _heap[a]->index = a;
+    _heap[b]->index = b;
+}
+
+static void _heap_up(int i)
+{
+    while (i > 0 && _heap[(i-1)/2]->expires > _heap[i]->expires)
+    {
+        _heap_swap(i, (i-1)/2);
+        i = (i-1)/2;
+    }
+}
+
+static void _heap_down(int i)
+{
+    int child;
+
+    for (;;)
+    {
+        child = 2*i + 1;
+        if (child >= _heap_num) break;
+        if (child + 1 < _heap_num && _heap[child+1]->expires < _heap[child]->expires) child++;
+        if (_heap[i]->expires <= _heap[child]->expires) break;
+        _heap_swap(i, child);
+        i = child;
+    }
+}
+
+static void _heap_remove(struct hrtimer *timer)
+{
+    int i = timer->index;
+
+    timer->index = -1;
+    if (--_heap_num == i) return;
+    _heap[i] = _heap[_heap_num];
+    _heap[i]->index = i;
+    _heap_up(i);
+    _heap_down(_heap[i]->index);
+}
+
+static rt_err_t _heap_insert(struct hrtimer *timer)
+{
+    if (_heap_num == HRTIMER_MAX) return -RT_EFULL;
+    timer->index = _heap_num;
+    _heap[_heap_num++] = timer;
+    _heap_up(timer->index);
+    return RT_EOK;
+}
+
+/* one-shot for the nearest deadline, off when there is none */
+static void _hrtimer_program(void)
+{
+    rt_uint64_t now, delta;
+
+    if (_heap_num == 0)
+    {
+        hr_timer_stop();
+        _armed = 0;
+        return;
+    }
+    now = get_ticks();
+    delta = _heap[0]->expires > now ? _heap[0]->expires - now : 0;
+    if (delta < HRTIMER_SLACK) delta = HRTIMER_SLACK;
+    if (delta > HRTIMER_MAX_COUNTS) delta = HRTIMER_MAX_COUNTS;
+    hr_timer_oneshot((ulong)delta);
+    _armed = now + delta;
+}
+
+static void _hrtimer_queue(struct hrtimer *timer)
+{
+    /* a thread callback still waiting counts the new expiry as an overrun */
+    if (timer->queued)
+    {
+        timer->overruns++;
+        return;
+    }
+    timer->queued = 1;
+    timer->next = RT_NULL;
+    if (_queue_tail) _queue_tail->next = timer;
+    else _queue_head = timer;
+    _queue_tail = timer;
+    rt_sem_release(&_queue_sem);
+}
+
+static void _hrtimer_isr(int vector, void *param)
+{
+    struct hrtimer *timer;
+    rt_uint64_t now;
+
+    hr_timer_ack();
+    now = get_ticks();
+    /* never before the deadline, a near one gets another HRTIMER_SLACK shot */
+    while (_heap_num > 0 && _heap[0]->expires <= now)
+    {
+        timer = _heap[0];
+        _heap_remove(timer);
+        timer->fired = timer->expires;
+
+        /* re-armed before the callback, which may cancel or restart it */
+        if (timer->period)
+        {
+            timer->expires += timer->period;
+            while (timer->expires <= now)
+            {
+                timer->expires += timer->period;
+                timer->overruns++;
+            }
+            _heap_insert(timer);
+        }
+
+        if (timer->flags & HRTIMER_FLAG_THREAD)
+            _hrtimer_queue(timer);
+        else
+            timer->func(timer, timer->param);
+        now = get_ticks();
+    }
+    _hrtimer_program();
+}
+
+#ifdef RT_USING_INTERRUPT_INFO
+static rt_uint64_t _hrtimer_raised(int vector)
+{
+    return _armed;
+}
+#endif
+
+static void _hrtimer_thread_entry(void *parameter)
+{
+    struct hrtimer *timer;
+    rt_base_t level;
+
+    for (;;)
+    {
+        rt_sem_take(&_queue_sem, RT_WAITING_FOREVER);
+
+        level = rt_hw_interrupt_disable();
+        timer = _queue_head;
+        if (timer)
+        {
+            _queue_head = timer->next;
+            if (_queue_head == RT_NULL) _queue_tail = RT_NULL;
+            timer->queued = 0;
+        }
+        rt_hw_interrupt_enable(level);
+
+        if (timer) timer->func(timer, timer->param);
+    }
+}
+
+/* 24 counts per microsecond, 3 per 125 ns */
+static rt_uint64_t _hrtimer_counts(rt_uint64_t ns)
+{
+    if (ns < 0xffffffffu / 3) return (rt_uint32_t)ns * 3 / 125;
+    return ns / 125 * 3 + (rt_uint32_t)(ns % 125) * 3 / 125;
+}
+
+void hrtimer_init(struct hrtimer *timer, hrtimer_func_t func, void *param, int flags)
+{
+    rt_memset(timer, 0, sizeof(*timer));
+    timer->func = func;
+    timer->param = param;
+    timer->flags = flags;
+    timer->index = -1;
+}
+
+rt_err_t hrtimer_start_at(struct hrtimer *timer, rt_uint64_t expires)
+{
+    rt_base_t level;
+    rt_err_t ret;
+
+    level = rt_hw_interrupt_disable();
+    if (timer->index >= 0) _heap_remove(timer);
+    timer->expires = expires;
+    ret = _heap_insert(timer);
+    if (ret == RT_EOK && timer->index == 0) _hrtimer_program();
+    rt_hw_interrupt_enable(level);
+
+    return ret;
+}
+
+rt_err_t hrtimer_start(struct hrtimer *timer, rt_uint64_t delay_ns, rt_uint64_t period_ns)
+{
+    timer->period = _hrtimer_counts(period_ns);
+    timer->overruns = 0;
+    return hrtimer_start_at(timer, get_ticks() + _hrtimer_counts(delay_ns));
+}
+
+void hrtimer_cancel(struct hrtimer *timer)
+{
+    struct hrtimer **p;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (timer->index >= 0)
+    {
+        _heap_remove(timer);
+        _hrtimer_program();
+    }
+    /* a callback already handed to the thread is dropped as well */
+    if (timer->queued)
+    {
+        for (p = &_queue_head; *p != timer; p = &(*p)->next) ;
+        *p = timer->next;
+        if (_queue_tail == timer)
+        {
+            for (_queue_tail = _queue_head; _queue_tail && _queue_tail->next; _queue_tail = _queue_tail->next) ;
+        }
+        timer->queued = 0;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+int rt_hw_hrtimer_init(void)
+{
+    rt_thread_t tid;
+
+    rt_sem_init(&_queue_sem, "hrtimer", 0, RT_IPC_FLAG_FIFO);
+    tid = rt_thread_create("hrtimer", _hrtimer_thread_entry, RT_NULL,
+        2048, 2, 10);
+    if (tid == RT_NULL) return -1;
+    rt_thread_startup(tid);
+
+    hr_timer_init();
+    rt_hw_interrupt_install(HRTIMER_IRQ, _hrtimer_isr, RT_NULL, "hrtimer");
+    rt_hw_interrupt_set_priority(HRTIMER_IRQ, IRQ_PRIO_HRTIMER);
+#ifdef RT_USING_INTERRUPT_INFO
+    rt_hw_interrupt_set_raised(HRTIMER_IRQ, _hrtimer_raised);
+#endif
+    rt_hw_interrupt_umask(HRTIMER_IRQ);
+
+    return 0;
+}
+INIT_DEVICE_EXPORT(rt_hw_hrtimer_init);
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#include <stdlib.h>
+
+/* deadline error histogram, bucket upper bounds in ns */
+static const rt_uint32_t _bench_bound[] = {1000, 2000, 5000, 10000, 20000, 50000, 100000, 1000000};
+#define BENCH_BUCKETS   (sizeof(_bench_bound) / sizeof(_bench_bound[0]) + 1)
+
+struct hrtimer_bench
+{
+    volatile int left;
+    rt_uint32_t early, earliest;    /* expiries before the deadline, the worst in ns */
+    rt_uint32_t min, max;
+    rt_uint64_t sum;
+    rt_uint32_t hist[BENCH_BUCKETS];
+    struct rt_semaphore done;
+};
+
+static void _bench_func(struct hrtimer *timer, void *param)
+{
+    struct hrtimer_bench *bench = (struct hrtimer_bench *)param;
+    rt_int64_t delta;
+    rt_uint32_t err, i;
+
+    if (bench->left <= 0) return;
+    delta = (rt_int64_t)(get_ticks() - timer->fired) * 125 / 3;
+    if (delta < 0)
+    {
+        bench->early++;
+        if ((rt_uint32_t)-delta > bench->earliest) bench->earliest = (rt_uint32_t)-delta;
+    }
+    else
+    {
+        err = (rt_uint32_t)delta;
+        if (err < bench->min) bench->min = err;
+        if (err > bench->max) bench->max = err;
+        bench->sum += err;
+        for (i = 0; i < BENCH_BUCKETS - 1 && err >= _bench_bound[i]; i++) ;
+        bench->hist[i]++;
+    }
+
+    if (--bench->left == 0)
+    {
+        hrtimer_cancel(timer);
+        rt_sem_release(&bench->done);
+    }
+}
+
+static void _bench_run(const char *name, int flags, int period_us, int count)
+{
+    struct hrtimer_bench bench;
+    struct hrtimer timer;
+    int i, n;
+
+    rt_memset(&bench, 0, sizeof(bench));
+    bench.left = count;
+    bench.min = ~0u;
+    rt_sem_init(&bench.done, "hrbench", 0, RT_IPC_FLAG_FIFO);
+    hrtimer_init(&timer, _bench_func, &bench, flags);
+    hrtimer_start(&timer, period_us * 1000ull, period_us * 1000ull);
+    if (rt_sem_take(&bench.done, RT_TICK_PER_SECOND + count * period_us / (1000000 / RT_TICK_PER_SECOND)) != RT_EOK)
+        rt_kprintf("%s: timed out\n", name);
+    hrtimer_cancel(&timer);
+    rt_sem_detach(&bench.done);
+
+    n = count - bench.left;
+    if (n <= 0) return;
+    rt_kprintf("%-7s %d expiries every %d us, %d overruns, %d early", name, n, period_us,
+        timer.overruns, bench.early);
+    if (bench.early) rt_kprintf(" (up to %d ns)", bench.earliest);
+    n -= bench.early;
+    if (n > 0)
+        rt_kprintf(", error min %d avg %d max %d ns", bench.min, (int)(bench.sum / n), bench.max);
+    rt_kprintf("\n");
+    for (i = 0; i < BENCH_BUCKETS; i++)
+    {
+        if (i < BENCH_BUCKETS - 1)
+            rt_kprintf("  < %7d ns %7d\n", _bench_bound[i], bench.hist[i]);
+        else
+            rt_kprintf(" >= %7d ns %7d\n", _bench_bound[i-1], bench.hist[i]);
+    }
+}
+
+/* how late periodic callbacks run, in the interrupt and in the thread */
+int hrtimer_bench(int argc, char** argv)
+{
+    int period_us = 250, count = 4000;
+
+    if (argc > 1) period_us = atol(argv[1]);
+    if (argc > 2) count = atol(argv[2]);
+    if (period_us < 10) period_us = 10;
+    if (count <= 0) count = 1;
+
+    _bench_run("irq", 0, period_us, count);
+    _bench_run("thread", HRTIMER_FLAG_THREAD, period_us, count);
+
+    return 0;
+}
+MSH_CMD_EXPORT(hrtimer_bench, hrtimer deadline error histogram: [period_us] [count]);
+#endif
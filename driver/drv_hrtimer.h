@@ -0,0 +1,64 @@
+/*
+ * File      : drv_hrtimer.h
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef _DRV_HRTIMER_H_
+#define _DRV_HRTIMER_H_
+
+#include <rtthread.h>
+
+/*
+ * Timers with clocksource resolution instead of os ticks. Deadlines are
+ * kept in a min-heap and sunxi timer 1 is programmed one-shot for the
+ * nearest. Callbacks run in the timer interrupt, or with
+ * HRTIMER_FLAG_THREAD in the "hrtimer" thread, where they may block.
+ */
+#define HRTIMER_FLAG_THREAD     (1 << 0)
+
+struct hrtimer;
+typedef void (*hrtimer_func_t)(struct hrtimer *timer, void *param);
+
+struct hrtimer
+{
+    rt_uint64_t expires;        /* clocksource count, see get_ticks() */
+    rt_uint64_t period;         /* counts, 0 for one-shot */
+    rt_uint64_t fired;          /* deadline of the expiry being handled */
+    rt_uint32_t overruns;       /* periods skipped because they were already past */
+
+    hrtimer_func_t func;
+    void *param;
+    int flags;
+
+    /* private */
+    int index;                  /* heap slot, -1 while not armed */
+    int queued;                 /* waiting for the thread */
+    struct hrtimer *next;
+};
+
+void hrtimer_init(struct hrtimer *timer, hrtimer_func_t func, void *param, int flags);
+/* first expiry delay_ns from now, then every period_ns unless it is 0 */
+rt_err_t hrtimer_start(struct hrtimer *timer, rt_uint64_t delay_ns, rt_uint64_t period_ns);
+/* absolute clocksource deadline, periodic timers keep their period */
+rt_err_t hrtimer_start_at(struct hrtimer *timer, rt_uint64_t expires);
+void hrtimer_cancel(struct hrtimer *timer);
+
+#endif
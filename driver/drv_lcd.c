@@ -28,6 +28,22 @@
 
 #include "board.h"
 #include "interrupt.h"
+#include "drv_lcd.h"
+
+#define LCD_EVENT_FLIP      (1 << 0)
+#define LCD_EVENT_VSYNC     (1 << 1)
+
+#define LCD_LAYER_MAX       4
+
+/* hardware buffers, one has the gui draw on screen and never flips */
+#ifndef RT_LCD_FB_NUM
+#define RT_LCD_FB_NUM       2
+#endif
+
+#define LCD_IRQ_VBLANK      (1 << 0)
+#define LCD_IRQ_LINE        (1 << 1)
+/* early in the active area, a flip latched at frame start shows up here */
+#define LCD_IRQ_LINE_NUM    1
 
 struct lcdfb_device
 {
@@ -35,7 +51,40 @@ struct lcdfb_device
     struct rt_device_graphic_info info;
     int index;
     int bufsize;
-    void* fb_address[2];
+    int pitch;
+    int fb_num;
+    void* fb_address[RT_LCD_FB_NUM];
+    /* area each hardware buffer misses compared to the framebuffer */
+    struct rt_device_rect_info dirty[RT_LCD_FB_NUM];
+    /* what the gui draws into when copying, freed while page flipping */
+    void* shadow;
+
+    int flip_mode;
+    /* fb_address[index] was handed to the composer but not latched yet */
+    volatile int flip_pending;
+    /* buffer scanned out, index once the pending flip latched */
+    volatile int front;
+    /* newest finished frame the display has not taken yet, -1 for none */
+    volatile int flip_ready;
+    /* buffer handed out to draw into while page flipping */
+    int back;
+    struct rt_event event;
+
+    /* frame counter and time of the last vertical blank */
+    volatile rt_uint32_t vblank;
+    rt_uint32_t vblank_us;
+    /* vblank when the pending flip was queued */
+    rt_uint32_t flip_vblank;
+    rt_uint32_t stats_us;
+    struct lcd_stats stats;
+
+    /* overlays indexed by mixer channel, free while framebuffer is null */
+    int primary;
+    int channels;
+    struct lcd_layer layer[LCD_LAYER_MAX];
+    /* blender pipe each one is on, -1 if not shown, and whether it was clipped */
+    int layer_pipe[LCD_LAYER_MAX];
+    int layer_clipped[LCD_LAYER_MAX];
 }; 
 
 static rt_err_t _lcd_init(rt_device_t device)
@@ -44,6 +93,558 @@ static rt_err_t _lcd_init(rt_device_t device)
 }
 
 extern void sunxi_composer_fbbase_set(void* fbbase);
+extern void flush_dcache_range(unsigned long start, unsigned long stop);
+extern int sunxi_composer_fbbase_pending(void);
+extern void sunxi_lcdc_irq_enable(int vblank, int line);
+extern int sunxi_lcdc_irq_ack(void);
+
+static void _lcd_stats_reset(struct lcdfb_device *lcdfb)
+{
+    rt_memset(&lcdfb->stats, 0, sizeof(lcdfb->stats));
+    lcdfb->stats.frame_us_min = ~0u;
+    lcdfb->stats_us = timer_get_us();
+}
+
+static void _lcd_time_add(rt_uint32_t *total, rt_uint32_t *max, rt_uint32_t us)
+{
+    *total += us;
+    if (us > *max) *max = us;
+}
+
+/*
+ * The line interrupt sees a flip in the frame it was latched for, the
+ * vertical blank only at its end, so both look for it.
+ */
+static void _lcd_flip_done(struct lcdfb_device *lcdfb)
+{
+    rt_uint32_t frames;
+
+    if (!lcdfb->flip_pending || sunxi_composer_fbbase_pending()) return;
+    lcdfb->flip_pending = 0;
+    lcdfb->front = lcdfb->index;
+
+    frames = lcdfb->vblank - lcdfb->flip_vblank;
+    lcdfb->stats.flips++;
+    if (frames > 1)
+    {
+        lcdfb->stats.flips_late++;
+        lcdfb->stats.frames_missed += frames - 1;
+    }
+    rt_event_send(&lcdfb->event, LCD_EVENT_FLIP);
+}
+
+static void _lcd_flip_program(struct lcdfb_device *lcdfb, int index)
+{
+    lcdfb->index = index;
+    sunxi_composer_fbbase_set(lcdfb->fb_address[index]);
+    lcdfb->flip_vblank = lcdfb->vblank;
+    lcdfb->flip_pending = 1;
+}
+
+static void _lcd_isr(int vector, void *param)
+{
+    struct lcdfb_device *lcdfb = (struct lcdfb_device *)param;
+    int irq = sunxi_lcdc_irq_ack();
+    rt_uint32_t now, period;
+
+    if (irq & LCD_IRQ_VBLANK)
+    {
+        now = timer_get_us();
+        period = now - lcdfb->vblank_us;
+        lcdfb->vblank_us = now;
+        lcdfb->vblank++;
+        /* the first one after a reset has no previous frame */
+        if (lcdfb->stats.vblanks++ > 0)
+        {
+            if (period < lcdfb->stats.frame_us_min) lcdfb->stats.frame_us_min = period;
+            if (period > lcdfb->stats.frame_us_max) lcdfb->stats.frame_us_max = period;
+        }
+        rt_event_send(&lcdfb->event, LCD_EVENT_VSYNC);
+    }
+    if (irq) _lcd_flip_done(lcdfb);
+
+    /*
+     * Render ahead: the newest finished frame goes to the composer in the
+     * blanking, as late as it can and still latch at the coming frame start.
+     */
+    if ((irq & LCD_IRQ_VBLANK) && !lcdfb->flip_pending && lcdfb->flip_ready >= 0)
+    {
+        _lcd_flip_program(lcdfb, lcdfb->flip_ready);
+        lcdfb->flip_ready = -1;
+    }
+}
+
+/* the composer picks the new address up at the next frame start */
+static void _lcd_flip_queue(struct lcdfb_device *lcdfb, int index)
+{
+    rt_uint32_t e;
+
+    /* drop a completion nobody waited for */
+    rt_event_recv(&lcdfb->event, LCD_EVENT_FLIP, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, 0, &e);
+    _lcd_flip_program(lcdfb, index);
+}
+
+/* no vertical blank for that long means the output is off, forget the flips */
+static void _lcd_flip_abort(struct lcdfb_device *lcdfb)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    lcdfb->flip_pending = 0;
+    lcdfb->flip_ready = -1;
+    lcdfb->front = lcdfb->index;
+    rt_hw_interrupt_enable(level);
+}
+
+/* block until the last frame handed to the display is on screen */
+static void _lcd_flip_wait(struct lcdfb_device *lcdfb)
+{
+    rt_uint32_t e;
+    unsigned long start;
+
+    if (!lcdfb->flip_pending && lcdfb->flip_ready < 0) return;
+    start = timer_get_us();
+    while (lcdfb->flip_pending || lcdfb->flip_ready >= 0)
+    {
+        if (rt_event_recv(&lcdfb->event, LCD_EVENT_FLIP, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                RT_TICK_PER_SECOND / 10, &e) != RT_EOK)
+        {
+            _lcd_flip_abort(lcdfb);
+            break;
+        }
+    }
+    lcdfb->stats.waits++;
+    _lcd_time_add(&lcdfb->stats.wait_us, &lcdfb->stats.wait_us_max, timer_get_us() - start);
+}
+
+static void _lcd_vsync_wait(struct lcdfb_device *lcdfb)
+{
+    rt_uint32_t e;
+
+    rt_event_recv(&lcdfb->event, LCD_EVENT_VSYNC, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, 0, &e);
+    rt_event_recv(&lcdfb->event, LCD_EVENT_VSYNC, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+        RT_TICK_PER_SECOND / 10, &e);
+}
+
+/* the buffers are cached, write rows back before the display engine reads them */
+static void _lcd_fb_flush(struct lcdfb_device *lcdfb, void *fb, int y, int height)
+{
+    unsigned long start = (unsigned long)fb + y * lcdfb->pitch;
+    unsigned long stop = start + height * lcdfb->pitch;
+
+    if (height <= 0) return;
+    flush_dcache_range(start & ~63ul, RT_ALIGN(stop, 64));
+}
+
+static void _lcd_rect_full(struct lcdfb_device *lcdfb, struct rt_device_rect_info *rect)
+{
+    rect->x = 0;
+    rect->y = 0;
+    rect->width = lcdfb->info.width;
+    rect->height = lcdfb->info.height;
+}
+
+static void _lcd_rect_union(struct rt_device_rect_info *dst, const struct rt_device_rect_info *src)
+{
+    int x1, y1, x2, y2;
+
+    if (src->width == 0 || src->height == 0) return;
+    if (dst->width == 0 || dst->height == 0)
+    {
+        *dst = *src;
+        return;
+    }
+    x1 = dst->x < src->x ? dst->x : src->x;
+    y1 = dst->y < src->y ? dst->y : src->y;
+    x2 = dst->x + dst->width > src->x + src->width ? dst->x + dst->width : src->x + src->width;
+    y2 = dst->y + dst->height > src->y + src->height ? dst->y + dst->height : src->y + src->height;
+    dst->x = x1;
+    dst->y = y1;
+    dst->width = x2 - x1;
+    dst->height = y2 - y1;
+}
+
+static void _lcd_rect_copy(struct lcdfb_device *lcdfb, void *dst, const struct rt_device_rect_info *rect)
+{
+    int bpp = lcdfb->info.bits_per_pixel == 16 ? 2 : 4;
+    int offset = rect->y * lcdfb->pitch + rect->x * bpp;
+    int len = rect->width * bpp;
+    int row;
+
+    if (rect->width == 0 || rect->height == 0) return;
+    if (len == lcdfb->pitch)
+    {
+        rt_memcpy((char *)dst + offset, (char *)lcdfb->info.framebuffer + offset, len * rect->height);
+        return;
+    }
+    for (row = 0; row < rect->height; row++, offset += lcdfb->pitch)
+        rt_memcpy((char *)dst + offset, (char *)lcdfb->info.framebuffer + offset, len);
+}
+
+/*
+ * Bring the next hardware buffer up to date and show it. The buffer was
+ * last written fb_num updates ago, so it gets the union of what changed
+ * since then instead of the whole frame.
+ */
+static void _lcd_rect_update(struct lcdfb_device *lcdfb, struct rt_device_rect_info *rect)
+{
+    struct rt_device_rect_info area;
+    unsigned long start;
+    int i, next;
+
+    _lcd_rect_full(lcdfb, &area);
+    if (rect != RT_NULL)
+    {
+        if (rect->x >= lcdfb->info.width || rect->y >= lcdfb->info.height) return;
+        area = *rect;
+        if (area.x + area.width > lcdfb->info.width) area.width = lcdfb->info.width - area.x;
+        if (area.y + area.height > lcdfb->info.height) area.height = lcdfb->info.height - area.y;
+    }
+
+    if (lcdfb->fb_num == 1)
+    {
+        /* the gui draws straight into the only buffer */
+        _lcd_fb_flush(lcdfb, lcdfb->fb_address[0], area.y, area.height);
+        return;
+    }
+
+    for (i = 0; i < lcdfb->fb_num; i++) _lcd_rect_union(&lcdfb->dirty[i], &area);
+
+    /* the buffer about to be written stays on screen until the last flip latched */
+    _lcd_flip_wait(lcdfb);
+    next = (lcdfb->index+1) % lcdfb->fb_num;
+    start = timer_get_us();
+    _lcd_rect_copy(lcdfb, lcdfb->fb_address[next], &lcdfb->dirty[next]);
+    _lcd_fb_flush(lcdfb, lcdfb->fb_address[next], lcdfb->dirty[next].y, lcdfb->dirty[next].height);
+    lcdfb->stats.copies++;
+    _lcd_time_add(&lcdfb->stats.copy_us, &lcdfb->stats.copy_us_max, timer_get_us() - start);
+    rt_memset(&lcdfb->dirty[next], 0, sizeof(lcdfb->dirty[0]));
+    _lcd_flip_queue(lcdfb, next);
+}
+
+/* show the buffer the application drew into and hand it the next one */
+static void _lcd_page_flip(struct lcdfb_device *lcdfb)
+{
+    _lcd_flip_wait(lcdfb);
+    _lcd_fb_flush(lcdfb, lcdfb->fb_address[lcdfb->back], 0, lcdfb->info.height);
+    _lcd_flip_queue(lcdfb, lcdfb->back);
+    lcdfb->back = (lcdfb->index+1) % lcdfb->fb_num;
+    lcdfb->info.framebuffer = lcdfb->fb_address[lcdfb->back];
+}
+
+/*
+ * Render ahead: post the finished frame, replacing one the display has
+ * not taken yet, and hand out a buffer that is neither on screen nor
+ * about to be. With three buffers that only waits while a flip latches.
+ */
+static void _lcd_flip_submit(struct lcdfb_device *lcdfb)
+{
+    rt_base_t level;
+    rt_uint32_t e;
+    int i;
+
+    _lcd_fb_flush(lcdfb, lcdfb->fb_address[lcdfb->back], 0, lcdfb->info.height);
+    level = rt_hw_interrupt_disable();
+    if (lcdfb->flip_ready >= 0) lcdfb->stats.frames_dropped++;
+    lcdfb->flip_ready = lcdfb->back;
+    rt_hw_interrupt_enable(level);
+
+    for (;;)
+    {
+        level = rt_hw_interrupt_disable();
+        for (i = 0; i < lcdfb->fb_num; i++)
+            if (i != lcdfb->front && i != lcdfb->index && i != lcdfb->flip_ready) break;
+        rt_hw_interrupt_enable(level);
+        if (i < lcdfb->fb_num) break;
+
+        if (rt_event_recv(&lcdfb->event, LCD_EVENT_FLIP, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                RT_TICK_PER_SECOND / 10, &e) != RT_EOK)
+            _lcd_flip_abort(lcdfb);
+    }
+    lcdfb->back = i;
+    lcdfb->info.framebuffer = lcdfb->fb_address[i];
+}
+
+static rt_err_t _lcd_flip_mode(struct lcdfb_device *lcdfb, int mode)
+{
+    int size = lcdfb->pitch * lcdfb->info.height;
+    int i;
+
+    if (mode < LCD_FLIP_COPY || mode > LCD_FLIP_QUEUE) return -RT_EINVAL;
+    if (mode == lcdfb->flip_mode) return RT_EOK;
+    if (lcdfb->fb_num < mode + 1) return -RT_ERROR;
+
+    /* every mode starts with nothing in flight and front == index */
+    _lcd_flip_wait(lcdfb);
+    if (lcdfb->flip_mode == LCD_FLIP_COPY)
+    {
+        lcdfb->back = (lcdfb->index+1) % lcdfb->fb_num;
+        rt_memcpy(lcdfb->fb_address[lcdfb->back], lcdfb->shadow, size);
+        lcdfb->info.framebuffer = lcdfb->fb_address[lcdfb->back];
+        rt_free(lcdfb->shadow);
+        lcdfb->shadow = RT_NULL;
+    }
+    else if (mode == LCD_FLIP_COPY)
+    {
+        lcdfb->shadow = rt_malloc(lcdfb->bufsize);
+        if (lcdfb->shadow == RT_NULL) return -RT_ENOMEM;
+
+        /* the screen becomes the reference, the other buffers are stale */
+        rt_memcpy(lcdfb->shadow, lcdfb->fb_address[lcdfb->index], size);
+        lcdfb->info.framebuffer = lcdfb->shadow;
+        for (i = 0; i < lcdfb->fb_num; i++) _lcd_rect_full(lcdfb, &lcdfb->dirty[i]);
+        rt_memset(&lcdfb->dirty[lcdfb->index], 0, sizeof(lcdfb->dirty[0]));
+    }
+    /* between the two page flipping modes the back buffer stays */
+    lcdfb->flip_mode = mode;
+
+    return RT_EOK;
+}
+
+extern int sunxi_composer_channels(int *primary);
+extern int sunxi_composer_layer_set(int channel, int depth, void *fbbase,
+    int pitch, int width, int height, int alpha);
+extern void sunxi_composer_layer_disable(int channel);
+extern void sunxi_composer_pipe_set(int pipe, int channel, int x, int y, int width, int height);
+extern void sunxi_composer_pipe_disable(int pipe);
+extern void sunxi_composer_pipe_move(int pipe, int x, int y);
+extern int sunxi_composer_scaler_set(int channel, int in_w, int in_h, int out_w, int out_h);
+extern void sunxi_composer_commit(void);
+
+static int _lcd_layer_bpp(int format)
+{
+    return format == RTGRAPHIC_PIXEL_FORMAT_RGB565 ? 2 : 4;
+}
+
+static int _lcd_layer_depth(int format)
+{
+    switch (format)
+    {
+    case RTGRAPHIC_PIXEL_FORMAT_RGB565:
+        return 16;
+    case RTGRAPHIC_PIXEL_FORMAT_RGB888:
+        return 24;
+    default:
+        return 32;
+    }
+}
+
+static struct lcd_layer *_lcd_layer_get(struct lcdfb_device *lcdfb, int id)
+{
+    if (id < 0 || id >= lcdfb->channels || id == lcdfb->primary) return RT_NULL;
+    if (lcdfb->layer[id].framebuffer == RT_NULL) return RT_NULL;
+    return &lcdfb->layer[id];
+}
+
+/*
+ * Program the part of a layer that is on screen, 0 if there is none.
+ * Whatever is cut off the screen is cut off the source in proportion.
+ */
+static int _lcd_layer_load(struct lcdfb_device *lcdfb, struct lcd_layer *layer, int pipe)
+{
+    int bpp = _lcd_layer_bpp(layer->pixel_format);
+    int pitch = layer->width * bpp;
+    int sx = layer->src.x, sy = layer->src.y, sw = layer->src.width, sh = layer->src.height;
+    int x = layer->x, y = layer->y;
+    int w = layer->dst_width ? layer->dst_width : sw;
+    int h = layer->dst_height ? layer->dst_height : sh;
+    int cut;
+
+    if (x < 0) { cut = -x * sw / w; sx += cut; sw -= cut; w += x; x = 0; }
+    if (y < 0) { cut = -y * sh / h; sy += cut; sh -= cut; h += y; y = 0; }
+    if (x + w > lcdfb->info.width)
+    {
+        sw -= (x + w - lcdfb->info.width) * sw / w;
+        w = lcdfb->info.width - x;
+    }
+    if (y + h > lcdfb->info.height)
+    {
+        sh -= (y + h - lcdfb->info.height) * sh / h;
+        h = lcdfb->info.height - y;
+    }
+    if (w <= 0 || h <= 0 || sw <= 0 || sh <= 0) return 0;
+    lcdfb->layer_clipped[layer->id] = x != layer->x || y != layer->y ||
+        w != (layer->dst_width ? layer->dst_width : layer->src.width) ||
+        h != (layer->dst_height ? layer->dst_height : layer->src.height);
+
+    sunxi_composer_layer_set(layer->id, _lcd_layer_depth(layer->pixel_format),
+        (char *)layer->framebuffer + sy * pitch + sx * bpp, pitch, sw, sh, layer->alpha);
+    if (sunxi_composer_scaler_set(layer->id, sw, sh, w, h) != 0) return 0;
+    sunxi_composer_pipe_set(pipe, layer->id, x, y, w, h);
+    lcdfb->layer_pipe[layer->id] = pipe;
+    return 1;
+}
+
+/*
+ * Rebuild the blender pipes from the z-order. The framebuffer keeps
+ * pipe 0, visible overlays take the next ones bottom to top.
+ */
+static void _lcd_layer_commit(struct lcdfb_device *lcdfb)
+{
+    struct lcd_layer *order[LCD_LAYER_MAX];
+    struct lcd_layer *layer;
+    int i, j, n = 0, pipe = 1;
+
+    for (i = 0; i < lcdfb->channels; i++)
+    {
+        lcdfb->layer_pipe[i] = -1;
+        layer = &lcdfb->layer[i];
+        if (i == lcdfb->primary || layer->framebuffer == RT_NULL) continue;
+        if (!layer->visible)
+        {
+            sunxi_composer_layer_disable(i);
+            continue;
+        }
+        /* stable, equal z-order keeps the channel order */
+        for (j = n; j > 0 && order[j-1]->zorder > layer->zorder; j--) order[j] = order[j-1];
+        order[j] = layer;
+        n++;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        if (_lcd_layer_load(lcdfb, order[i], pipe)) pipe++;
+        else sunxi_composer_layer_disable(order[i]->id);
+    }
+    for (; pipe < lcdfb->channels; pipe++) sunxi_composer_pipe_disable(pipe);
+    sunxi_composer_commit();
+}
+
+static rt_err_t _lcd_layer_alloc(struct lcdfb_device *lcdfb, struct lcd_layer *cfg)
+{
+    struct lcd_layer *layer;
+    int i, size;
+
+    if (cfg->width <= 0 || cfg->height <= 0) return -RT_EINVAL;
+    if (cfg->pixel_format != RTGRAPHIC_PIXEL_FORMAT_RGB565 &&
+        cfg->pixel_format != RTGRAPHIC_PIXEL_FORMAT_RGB888 &&
+        cfg->pixel_format != RTGRAPHIC_PIXEL_FORMAT_ARGB888)
+        return -RT_EINVAL;
+
+    for (i = 0; i < lcdfb->channels; i++)
+        if (i != lcdfb->primary && lcdfb->layer[i].framebuffer == RT_NULL) break;
+    if (i == lcdfb->channels) return -RT_EBUSY;
+
+    layer = &lcdfb->layer[i];
+    size = cfg->width * cfg->height * _lcd_layer_bpp(cfg->pixel_format);
+    /* cache line aligned, the buffer is written back before it is shown */
+    layer->framebuffer = rt_malloc_align(size, 64);
+    if (layer->framebuffer == RT_NULL) return -RT_ENOMEM;
+    rt_memset(layer->framebuffer, 0, size);
+
+    layer->id = i;
+    layer->pixel_format = cfg->pixel_format;
+    layer->width = cfg->width;
+    layer->height = cfg->height;
+    layer->src.x = 0;
+    layer->src.y = 0;
+    layer->src.width = cfg->width;
+    layer->src.height = cfg->height;
+    layer->x = 0;
+    layer->y = 0;
+    layer->dst_width = 0;
+    layer->dst_height = 0;
+    layer->alpha = 255;
+    layer->zorder = 0;
+    layer->visible = 0;
+    *cfg = *layer;
+
+    return RT_EOK;
+}
+
+static rt_err_t _lcd_layer_set(struct lcdfb_device *lcdfb, struct lcd_layer *cfg)
+{
+    struct lcd_layer *layer = _lcd_layer_get(lcdfb, cfg->id);
+    unsigned long start;
+
+    if (layer == RT_NULL) return -RT_EINVAL;
+    if (cfg->dst_width < 0 || cfg->dst_height < 0) return -RT_EINVAL;
+    if (cfg->src.x >= layer->width || cfg->src.y >= layer->height) return -RT_EINVAL;
+
+    layer->src = cfg->src;
+    if (layer->src.width == 0 || layer->src.x + layer->src.width > layer->width)
+        layer->src.width = layer->width - layer->src.x;
+    if (layer->src.height == 0 || layer->src.y + layer->src.height > layer->height)
+        layer->src.height = layer->height - layer->src.y;
+    layer->x = cfg->x;
+    layer->y = cfg->y;
+    layer->dst_width = cfg->dst_width;
+    layer->dst_height = cfg->dst_height;
+    layer->alpha = cfg->alpha < 0 ? 0 : (cfg->alpha > 255 ? 255 : cfg->alpha);
+    layer->zorder = cfg->zorder;
+    layer->visible = cfg->visible;
+
+    start = (unsigned long)layer->framebuffer;
+    flush_dcache_range(start, start + RT_ALIGN(layer->width * layer->height *
+        _lcd_layer_bpp(layer->pixel_format), 64));
+    _lcd_layer_commit(lcdfb);
+
+    return RT_EOK;
+}
+
+/*
+ * A layer that stays entirely on screen moves by rewriting its blender
+ * position alone, anything else is a full commit.
+ */
+static rt_err_t _lcd_layer_move(struct lcdfb_device *lcdfb, struct lcd_layer *cfg)
+{
+    struct lcd_layer *layer = _lcd_layer_get(lcdfb, cfg->id);
+    int pipe, w, h;
+
+    if (layer == RT_NULL) return -RT_EINVAL;
+
+    layer->x = cfg->x;
+    layer->y = cfg->y;
+    if (!layer->visible) return RT_EOK;
+
+    pipe = lcdfb->layer_pipe[layer->id];
+    w = layer->dst_width ? layer->dst_width : layer->src.width;
+    h = layer->dst_height ? layer->dst_height : layer->src.height;
+    if (pipe > 0 && !lcdfb->layer_clipped[layer->id] && layer->x >= 0 && layer->y >= 0 &&
+        layer->x + w <= lcdfb->info.width && layer->y + h <= lcdfb->info.height)
+        sunxi_composer_pipe_move(pipe, layer->x, layer->y);
+    else
+        _lcd_layer_commit(lcdfb);
+
+    return RT_EOK;
+}
+
+static rt_err_t _lcd_layer_free(struct lcdfb_device *lcdfb, struct lcd_layer *cfg)
+{
+    struct lcd_layer *layer = _lcd_layer_get(lcdfb, cfg->id);
+    void *buf;
+
+    if (layer == RT_NULL) return -RT_EINVAL;
+
+    layer->visible = 0;
+    _lcd_layer_commit(lcdfb);
+    /* the mixer may still fetch it until the next frame */
+    _lcd_vsync_wait(lcdfb);
+    _lcd_vsync_wait(lcdfb);
+    buf = layer->framebuffer;
+    layer->framebuffer = RT_NULL;
+    rt_free_align(buf);
+
+    return RT_EOK;
+}
+
+/* a consistent copy, the interrupt updates part of it */
+static void _lcd_stats_get(struct lcdfb_device *lcdfb, struct lcd_stats *stats)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (stats == RT_NULL)
+        _lcd_stats_reset(lcdfb);
+    else
+    {
+        *stats = lcdfb->stats;
+        stats->elapsed_us = timer_get_us() - lcdfb->stats_us;
+        if (stats->vblanks < 2) stats->frame_us_min = 0;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
 static rt_err_t _lcd_control(rt_device_t device, int cmd, void *args)
 {
     struct lcdfb_device *lcdfb = (struct lcdfb_device *)device;
@@ -55,9 +656,39 @@ static rt_err_t _lcd_control(rt_device_t device, int cmd, void *args)
         rt_memcpy(args, &lcdfb->info, sizeof(lcdfb->info)); 
         break;
     case RTGRAPHIC_CTRL_RECT_UPDATE:
-        lcdfb->index = (lcdfb->index+1) % 2;
-        rt_memcpy(lcdfb->fb_address[lcdfb->index], lcdfb->info.framebuffer, lcdfb->bufsize);
-        sunxi_composer_fbbase_set(lcdfb->fb_address[lcdfb->index]);
+        if (lcdfb->flip_mode == LCD_FLIP_QUEUE)
+            _lcd_flip_submit(lcdfb);
+        else if (lcdfb->flip_mode == LCD_FLIP_PAGE)
+        {
+            _lcd_page_flip(lcdfb);
+            _lcd_flip_wait(lcdfb);
+        }
+        else
+            _lcd_rect_update(lcdfb, (struct rt_device_rect_info *)args);
+        break;
+    case RTGRAPHIC_CTRL_FLIP_MODE:
+        return _lcd_flip_mode(lcdfb, *(int *)args);
+    case RTGRAPHIC_CTRL_PAGE_FLIP:
+        if (lcdfb->flip_mode == LCD_FLIP_COPY) return -RT_ERROR;
+        if (lcdfb->flip_mode == LCD_FLIP_QUEUE) _lcd_flip_submit(lcdfb);
+        else _lcd_page_flip(lcdfb);
+        break;
+    case RTGRAPHIC_CTRL_WAIT_FLIP:
+        _lcd_flip_wait(lcdfb);
+        break;
+    case RTGRAPHIC_CTRL_WAIT_VSYNC:
+        _lcd_vsync_wait(lcdfb);
+        break;
+    case RTGRAPHIC_CTRL_LAYER_ALLOC:
+        return _lcd_layer_alloc(lcdfb, (struct lcd_layer *)args);
+    case RTGRAPHIC_CTRL_LAYER_SET:
+        return _lcd_layer_set(lcdfb, (struct lcd_layer *)args);
+    case RTGRAPHIC_CTRL_LAYER_FREE:
+        return _lcd_layer_free(lcdfb, (struct lcd_layer *)args);
+    case RTGRAPHIC_CTRL_LAYER_MOVE:
+        return _lcd_layer_move(lcdfb, (struct lcd_layer *)args);
+    case RTGRAPHIC_CTRL_GET_STATS:
+        _lcd_stats_get(lcdfb, (struct lcd_stats *)args);
         break;
     }
 
@@ -99,44 +730,132 @@ static void touch_thread_entry(void *parameter)
 #endif
 
 static struct lcdfb_device lcd; 
-extern void *video_hw_init_probe(void* base, rt_uint8_t *deep, rt_uint16_t* width, rt_uint16_t* height);
-int rt_hw_lcd_init(void)
+extern int video_hw_mode_probe(rt_uint8_t *depth, rt_uint16_t *width, rt_uint16_t *height);
+extern void video_hw_mode_set(void *fbbase);
+
+#ifdef BSP_USING_NOR_LFS
+#include <dfs_posix.h>
+
+/* what the display probe found last boot, lets it skip the edid read */
+#define LCD_MODE_CACHE      "/flash/lcd_mode.bin"
+#define LCD_MODE_CACHE_MAX  128
+
+extern int video_hw_mode_load(const void *buf, int size);
+extern int video_hw_mode_save(void *buf, int size);
+
+static int _lcd_mode_cache_load(rt_uint8_t *buf)
 {
-    lcd.index = 0;
-    lcd.fb_address[0] = RT_HW_HEAP_END;
-    lcd.fb_address[1] = lcd.fb_address[0] + 0x400000;
-    rt_memset(lcd.fb_address[0], 0, 0x400000);
-#if 0
-    rt_memset(lcd.fb_address[0], 0xff, 0x400000);
-    int i,j,color,size=4;
-    for (i=1; i<479; i++){
-        for (j=1; j<799; j++){
-            if (i<120) color = 0xff;
-            else if (i<240) color = 0xff00;
-            else if (i<360) color = 0xff0000;
-            else color = 0x00;
-            rt_memcpy(lcd.fb_address[0]+(i*800+j)*size, &color, size);
-        }
+    int fd, len;
+
+    fd = open(LCD_MODE_CACHE, O_RDONLY, 0);
+    if (fd < 0) return 0;
+    len = read(fd, buf, LCD_MODE_CACHE_MAX);
+    close(fd);
+    if (len <= 0) return 0;
+    if (video_hw_mode_load(buf, len) != 0) return 0;
+    return len;
+}
+
+/* flash is only written when the result differs from the cached one */
+static void _lcd_mode_cache_save(const rt_uint8_t *old, int old_len)
+{
+    rt_uint8_t buf[LCD_MODE_CACHE_MAX];
+    int fd, len;
+
+    len = video_hw_mode_save(buf, sizeof(buf));
+    if (len <= 0)
+    {
+        if (old_len > 0) unlink(LCD_MODE_CACHE);
+        return;
     }
-#endif
-#if 0
-    rt_memset(lcd.fb_address[0], 0xff, 0x400000);
-    int i,j,color,size=2;
-    for (i=1; i<479; i++){
-        for (j=1; j<799; j++){
-            if (i<120) color = 0x1f;
-            else if (i<240) color = 0x7e0;
-            else if (i<360) color = 0xf800;
-            else color = 0x00;
-            rt_memcpy(lcd.fb_address[0]+(i*800+j)*size, &color, size);
-        }
+    if (len == old_len && rt_memcmp(buf, old, len) == 0) return;
+
+    fd = open(LCD_MODE_CACHE, O_WRONLY | O_CREAT | O_TRUNC, 0);
+    if (fd < 0) return;
+    if (write(fd, buf, len) != len)
+    {
+        close(fd);
+        unlink(LCD_MODE_CACHE);
+        return;
     }
+    close(fd);
+}
+#endif
+int rt_hw_lcd_init(void)
+{
+    int i;
+#ifdef BSP_USING_NOR_LFS
+    rt_uint8_t cache[LCD_MODE_CACHE_MAX];
+    int cache_len = _lcd_mode_cache_load(cache);
+#endif
+
+    if (video_hw_mode_probe(&lcd.info.bits_per_pixel, &lcd.info.width, &lcd.info.height) != 0)
+        return -1;
+#ifdef BSP_USING_NOR_LFS
+    _lcd_mode_cache_save(cache, cache_len);
 #endif
-    rt_memset(lcd.fb_address[1], 0, 0x400000);
-    video_hw_init_probe(lcd.fb_address[0], &lcd.info.bits_per_pixel, &lcd.info.width, &lcd.info.height);
     lcd.info.pixel_format = (lcd.info.bits_per_pixel==16)?RTGRAPHIC_PIXEL_FORMAT_RGB565:RTGRAPHIC_PIXEL_FORMAT_RGB888;
-    lcd.bufsize = RT_ALIGN(lcd.info.width * lcd.info.height * (lcd.info.bits_per_pixel==16?2:4), 64);
-    lcd.info.framebuffer = rt_malloc(lcd.bufsize);
+    lcd.pitch = lcd.info.width * (lcd.info.bits_per_pixel==16?2:4);
+    lcd.bufsize = RT_ALIGN(lcd.pitch * lcd.info.height, 64);
+
+    /* as many buffers as configured and fit, plus the shadow if they flip */
+    for (lcd.fb_num = 0; lcd.fb_num < RT_LCD_FB_NUM; lcd.fb_num++)
+    {
+        lcd.fb_address[lcd.fb_num] = rt_malloc_align(lcd.bufsize, 64);
+        if (lcd.fb_address[lcd.fb_num] == RT_NULL) break;
+    }
+    if (lcd.fb_num > 1)
+    {
+        lcd.shadow = rt_malloc(lcd.bufsize);
+        if (lcd.shadow == RT_NULL)
+        {
+            while (lcd.fb_num > 1) rt_free_align(lcd.fb_address[--lcd.fb_num]);
+        }
+    }
+    if (lcd.fb_num == 0)
+    {
+        rt_kprintf("lcd: no memory for a %dx%d framebuffer\n", lcd.info.width, lcd.info.height);
+        return -1;
+    }
+    if (lcd.fb_num < RT_LCD_FB_NUM)
+        rt_kprintf("lcd: only %d of %d framebuffers\n", lcd.fb_num, RT_LCD_FB_NUM);
+
+    /*
+     * Only the buffer on screen is cleared now, the others are marked
+     * dirty and get the shadow copied in before they are shown.
+     */
+    lcd.index = 0;
+    rt_memset(lcd.fb_address[0], 0, lcd.bufsize);
+    _lcd_fb_flush(&lcd, lcd.fb_address[0], 0, lcd.info.height);
+    video_hw_mode_set(lcd.fb_address[0]);
+
+    if (lcd.fb_num > 1)
+    {
+        lcd.info.framebuffer = lcd.shadow;
+        rt_memset(lcd.shadow, 0, lcd.bufsize);
+    }
+    else
+        lcd.info.framebuffer = lcd.fb_address[0];
+    rt_memset(lcd.dirty, 0, sizeof(lcd.dirty));
+    for (i = 1; i < lcd.fb_num; i++) _lcd_rect_full(&lcd, &lcd.dirty[i]);
+    lcd.flip_mode = LCD_FLIP_COPY;
+    lcd.flip_pending = 0;
+    lcd.front = 0;
+    lcd.flip_ready = -1;
+    lcd.vblank = 0;
+    lcd.vblank_us = timer_get_us();
+    _lcd_stats_reset(&lcd);
+    rt_event_init(&lcd.event, "lcd", RT_IPC_FLAG_FIFO);
+    rt_memset(lcd.layer, 0, sizeof(lcd.layer));
+    for (i = 0; i < LCD_LAYER_MAX; i++) lcd.layer_pipe[i] = -1;
+    lcd.channels = sunxi_composer_channels(&lcd.primary);
+    if (lcd.channels > LCD_LAYER_MAX) lcd.channels = LCD_LAYER_MAX;
+
+    /* tcon vertical blank and line, time the buffer swaps */
+    rt_hw_interrupt_install(118, _lcd_isr, &lcd, "lcd");
+    rt_hw_interrupt_set_priority(118, IRQ_PRIO_DISPLAY);
+    sunxi_lcdc_irq_enable(1, LCD_IRQ_LINE_NUM);
+    rt_hw_interrupt_umask(118);
 
     lcd.device.type    = RT_Device_Class_Graphic; 
     lcd.device.init    = _lcd_init; 
@@ -158,3 +877,85 @@ int rt_hw_lcd_init(void)
     return 0;
 }
 INIT_EXPORT(rt_hw_lcd_init, "5.end");
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#include <stdlib.h>
+#include <string.h>
+/* frame time of RECT_UPDATE for typical gui damage patterns */
+int lcd_bench(int argc, char** argv)
+{
+    struct rt_device_rect_info rect[4];
+    const char *name[4] = {"cursor", "text line", "window", "full screen"};
+    rt_device_t dev = rt_device_find("lcd");
+    int i, n, loops = 100;
+    unsigned long start;
+
+    if (dev == RT_NULL)
+    {
+        rt_kprintf("can't find lcd device\n");
+        return -1;
+    }
+    if (argc > 1) loops = atol(argv[1]);
+    if (loops <= 0) loops = 1;
+
+    rect[0].x = lcd.info.width / 2; rect[0].y = lcd.info.height / 2; rect[0].width = 8; rect[0].height = 16;
+    rect[1].x = 0; rect[1].y = lcd.info.height / 2; rect[1].width = lcd.info.width; rect[1].height = 16;
+    rect[2].x = lcd.info.width / 4; rect[2].y = lcd.info.height / 4; rect[2].width = lcd.info.width / 2; rect[2].height = lcd.info.height / 2;
+    rect[3].x = 0; rect[3].y = 0; rect[3].width = lcd.info.width; rect[3].height = lcd.info.height;
+
+    for (i = 0; i < 4; i++)
+    {
+        /* settle both buffers so every pattern starts from a clean state */
+        rt_device_control(dev, RTGRAPHIC_CTRL_RECT_UPDATE, &rect[i]);
+        rt_device_control(dev, RTGRAPHIC_CTRL_RECT_UPDATE, &rect[i]);
+        start = timer_get_us();
+        for (n = 0; n < loops; n++)
+            rt_device_control(dev, RTGRAPHIC_CTRL_RECT_UPDATE, &rect[i]);
+        rt_kprintf("%-12s %4dx%-4d %8d us/frame\n", name[i], rect[i].width, rect[i].height,
+            (int)((timer_get_us() - start) / loops));
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(lcd_bench, measure lcd rect update frame time);
+
+/* 1/100 units of count per second, elapsed stays below the 71 minute timer wrap */
+static rt_uint32_t _lcd_rate(rt_uint32_t count, rt_uint32_t elapsed_us)
+{
+    rt_uint32_t ticks = elapsed_us / 10000;
+
+    return ticks ? count * 10000 / ticks : 0;
+}
+
+int lcd_stats(int argc, char** argv)
+{
+    rt_device_t dev = rt_device_find("lcd");
+    struct lcd_stats st;
+    rt_uint32_t hz;
+
+    if (dev == RT_NULL)
+    {
+        rt_kprintf("can't find lcd device\n");
+        return -1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "reset"))
+        return rt_device_control(dev, RTGRAPHIC_CTRL_GET_STATS, RT_NULL);
+
+    rt_device_control(dev, RTGRAPHIC_CTRL_GET_STATS, &st);
+    rt_kprintf("elapsed   %d ms, %d frames\n", st.elapsed_us / 1000, st.vblanks);
+    hz = _lcd_rate(st.vblanks, st.elapsed_us);
+    rt_kprintf("refresh   %d.%02d Hz, frame %d..%d us\n", hz / 100, hz % 100,
+        st.frame_us_min, st.frame_us_max);
+    hz = _lcd_rate(st.flips, st.elapsed_us);
+    rt_kprintf("flips     %d.%02d fps, %d late, %d frames missed, %d dropped\n", hz / 100, hz % 100,
+        st.flips_late, st.frames_missed, st.frames_dropped);
+    rt_kprintf("copy      %d, avg %d max %d us\n", st.copies,
+        st.copies ? st.copy_us / st.copies : 0, st.copy_us_max);
+    rt_kprintf("flip wait %d, avg %d max %d us\n", st.waits,
+        st.waits ? st.wait_us / st.waits : 0, st.wait_us_max);
+
+    return 0;
+}
+MSH_CMD_EXPORT(lcd_stats, show lcd frame timing or reset it);
+#endif
@@ -0,0 +1,118 @@
+/*
+ * File      : drv_lcd.h
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef _DRV_LCD_H_
+#define _DRV_LCD_H_
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+/*
+ * Page flip mode. The framebuffer returned by GET_INFO is a hardware
+ * buffer that is not on screen; PAGE_FLIP shows it at the next frame
+ * start and hands out the next one. That buffer may still be scanned out
+ * until the flip completes, so wait with WAIT_FLIP and fetch GET_INFO
+ * again before drawing into it. RECT_UPDATE in this mode is a blocking
+ * PAGE_FLIP, the rectangle is ignored. Not available with a single
+ * buffer (RT_LCD_FB_NUM), where the gui always draws on screen.
+ *
+ * Render-ahead mode needs three buffers. PAGE_FLIP and RECT_UPDATE post
+ * the finished frame and return a buffer that is free to draw into right
+ * away; the display takes the newest posted frame at each vertical blank
+ * and frames it never took are dropped. Fetch GET_INFO after each one.
+ */
+#define LCD_FLIP_COPY               0       /* gui draws into a shadow, RECT_UPDATE copies */
+#define LCD_FLIP_PAGE               1
+#define LCD_FLIP_QUEUE              2       /* render ahead */
+
+#define RTGRAPHIC_CTRL_FLIP_MODE    0x20    /* args: int *, one of LCD_FLIP_* */
+#define RTGRAPHIC_CTRL_PAGE_FLIP    0x21    /* queue the current framebuffer, does not block */
+#define RTGRAPHIC_CTRL_WAIT_FLIP    0x22    /* block until the last queued buffer is on screen */
+#define RTGRAPHIC_CTRL_WAIT_VSYNC   0x23    /* block until the next vertical blank */
+
+/*
+ * Hardware overlay layers, composed over the framebuffer by the display
+ * engine instead of being drawn into it. LAYER_ALLOC takes pixel_format,
+ * width and height and returns id and a hidden layer's framebuffer.
+ * LAYER_SET applies position, size, alpha, zorder and visible; call it
+ * again after drawing, it also writes the buffer back from the cache.
+ * The src part of the buffer is shown at dst_width x dst_height by the
+ * display engine scalers, up to 4 times smaller and any size larger.
+ */
+#define RTGRAPHIC_CTRL_LAYER_ALLOC  0x24    /* args: struct lcd_layer * */
+#define RTGRAPHIC_CTRL_LAYER_SET    0x25    /* args: struct lcd_layer * */
+#define RTGRAPHIC_CTRL_LAYER_FREE   0x26    /* args: struct lcd_layer * */
+
+/*
+ * Move a layer to the x and y given and change nothing else. While the
+ * layer stays entirely on screen this is one blender register write, no
+ * redraw and no copy, cheap enough for a cursor or sprite following the
+ * touch point. Allocate a small ARGB888 layer with a high zorder for it.
+ */
+#define RTGRAPHIC_CTRL_LAYER_MOVE   0x28    /* args: struct lcd_layer *, only id, x and y are used */
+
+struct lcd_layer
+{
+    int id;
+    int pixel_format;       /* RGB565, RGB888 (stored as 32 bit) or ARGB888 */
+    int width;
+    int height;
+    void *framebuffer;
+
+    struct rt_device_rect_info src;     /* zero width or height shows all of it */
+    int x, y;               /* may be partly off screen */
+    int dst_width;          /* zero is the source size */
+    int dst_height;
+    int alpha;              /* 255 is opaque, video channels ignore it */
+    int zorder;             /* higher is on top, all above the framebuffer */
+    int visible;
+};
+
+/*
+ * Frame timing since the last reset, times in microseconds. A flip is
+ * late when it was not on screen in the frame after the one it was
+ * queued in, every frame it stayed off screen beyond that is missed.
+ */
+#define RTGRAPHIC_CTRL_GET_STATS    0x27    /* args: struct lcd_stats *, null resets them */
+
+struct lcd_stats
+{
+    rt_uint32_t elapsed_us;
+    rt_uint32_t vblanks;
+    rt_uint32_t frame_us_min;
+    rt_uint32_t frame_us_max;
+
+    rt_uint32_t flips;
+    rt_uint32_t flips_late;
+    rt_uint32_t frames_missed;
+    rt_uint32_t frames_dropped; /* render ahead frames replaced before shown */
+
+    rt_uint32_t copies;         /* RECT_UPDATE copies into a hardware buffer */
+    rt_uint32_t copy_us;
+    rt_uint32_t copy_us_max;
+    rt_uint32_t waits;          /* callers blocked on a pending flip */
+    rt_uint32_t wait_us;
+    rt_uint32_t wait_us_max;
+};
+
+#endif
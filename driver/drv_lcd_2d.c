@@ -0,0 +1,486 @@
+/*
+ * File      : drv_lcd_2d.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+
+#include "drv_lcd_2d.h"
+
+/* drv_lcd_2d_neon.S */
+extern void g2d_neon_fill16(rt_uint16_t *dst, rt_uint32_t color, int count);
+extern void g2d_neon_fill32(rt_uint32_t *dst, rt_uint32_t color, int count);
+extern void g2d_neon_copy(void *dst, const void *src, int bytes);
+extern void g2d_neon_rgb565_to_xrgb8888(rt_uint32_t *dst, const rt_uint16_t *src, int count);
+extern void g2d_neon_xrgb8888_to_rgb565(rt_uint16_t *dst, const rt_uint32_t *src, int count);
+extern void g2d_neon_blend_argb8888(rt_uint32_t *dst, const rt_uint32_t *src, int count, int alpha);
+
+static int _g2d_neon = 1;
+
+#define G2D_BPP(s)          ((s)->pixel_format == RTGRAPHIC_PIXEL_FORMAT_RGB565 ? 2 : 4)
+#define G2D_PIXEL(s, x, y)  ((rt_uint8_t *)(s)->pixels + (y) * (s)->pitch + (x) * G2D_BPP(s))
+
+rt_inline rt_uint32_t _div255(rt_uint32_t v)
+{
+    return (v + ((v + 128) >> 8) + 128) >> 8;
+}
+
+rt_inline rt_uint16_t _to_rgb565(rt_uint32_t c)
+{
+    return ((c >> 8) & 0xf800) | ((c >> 5) & 0x07e0) | ((c >> 3) & 0x001f);
+}
+
+rt_inline rt_uint32_t _to_xrgb8888(rt_uint16_t c)
+{
+    rt_uint32_t r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+
+    r = (r << 3) | (r >> 2);
+    g = (g << 2) | (g >> 4);
+    b = (b << 3) | (b >> 2);
+    return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+rt_inline rt_uint32_t _blend(rt_uint32_t d, rt_uint32_t s, int alpha)
+{
+    rt_uint32_t a = _div255((s >> 24) * alpha), na = 255 - a;
+    rt_uint32_t r = _div255(((s >> 16) & 0xff) * a + ((d >> 16) & 0xff) * na);
+    rt_uint32_t g = _div255(((s >> 8) & 0xff) * a + ((d >> 8) & 0xff) * na);
+    rt_uint32_t b = _div255((s & 0xff) * a + (d & 0xff) * na);
+
+    return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+/* the neon kernels take whole blocks, the c loops finish the row */
+static void _fill_row(void *dst, int bpp, rt_uint32_t color, int n)
+{
+    int i = 0;
+
+    if (bpp == 2)
+    {
+        rt_uint16_t *d = (rt_uint16_t *)dst, c = _to_rgb565(color);
+
+        if (_g2d_neon && n >= 16)
+        {
+            i = n & ~15;
+            g2d_neon_fill16(d, c, i);
+        }
+        for (; i < n; i++) d[i] = c;
+    }
+    else
+    {
+        rt_uint32_t *d = (rt_uint32_t *)dst;
+
+        if (_g2d_neon && n >= 8)
+        {
+            i = n & ~7;
+            g2d_neon_fill32(d, color, i);
+        }
+        for (; i < n; i++) d[i] = color;
+    }
+}
+
+static void _copy_row(void *dst, const void *src, int len)
+{
+    int i = 0;
+
+    if (_g2d_neon && len >= 32)
+    {
+        i = len & ~31;
+        g2d_neon_copy(dst, src, i);
+    }
+    if (i < len) rt_memcpy((rt_uint8_t *)dst + i, (const rt_uint8_t *)src + i, len - i);
+}
+
+static void _convert_row(void *dst, int bpp, const void *src, int n)
+{
+    int i = 0;
+
+    if (bpp == 4)
+    {
+        rt_uint32_t *d = (rt_uint32_t *)dst;
+        const rt_uint16_t *s = (const rt_uint16_t *)src;
+
+        if (_g2d_neon && n >= 8)
+        {
+            i = n & ~7;
+            g2d_neon_rgb565_to_xrgb8888(d, s, i);
+        }
+        for (; i < n; i++) d[i] = _to_xrgb8888(s[i]);
+    }
+    else
+    {
+        rt_uint16_t *d = (rt_uint16_t *)dst;
+        const rt_uint32_t *s = (const rt_uint32_t *)src;
+
+        if (_g2d_neon && n >= 8)
+        {
+            i = n & ~7;
+            g2d_neon_xrgb8888_to_rgb565(d, s, i);
+        }
+        for (; i < n; i++) d[i] = _to_rgb565(s[i]);
+    }
+}
+
+static void _blend_row(void *dst, int bpp, const rt_uint32_t *src, int n, int alpha)
+{
+    int i = 0;
+
+    if (bpp == 4)
+    {
+        rt_uint32_t *d = (rt_uint32_t *)dst;
+
+        if (_g2d_neon && n >= 8)
+        {
+            i = n & ~7;
+            g2d_neon_blend_argb8888(d, src, i, alpha);
+        }
+        for (; i < n; i++) d[i] = _blend(d[i], src[i], alpha);
+    }
+    else
+    {
+        rt_uint16_t *d = (rt_uint16_t *)dst;
+
+        for (; i < n; i++) d[i] = _to_rgb565(_blend(_to_xrgb8888(d[i]), src[i], alpha));
+    }
+}
+
+static void _g2d_rect(const struct lcd_surface *s, const struct rt_device_rect_info *rect,
+    int *x, int *y, int *w, int *h)
+{
+    if (rect == RT_NULL)
+    {
+        *x = 0; *y = 0; *w = s->width; *h = s->height;
+    }
+    else
+    {
+        *x = rect->x; *y = rect->y; *w = rect->width; *h = rect->height;
+    }
+}
+
+/* trim a w x h block going to (dx, dy) in dst from (sx, sy) in src */
+static int _g2d_clip(const struct lcd_surface *dst, int *dx, int *dy,
+    const struct lcd_surface *src, int *sx, int *sy, int *w, int *h)
+{
+    if (*dx < 0) { *sx -= *dx; *w += *dx; *dx = 0; }
+    if (*dy < 0) { *sy -= *dy; *h += *dy; *dy = 0; }
+    if (*dx + *w > dst->width) *w = dst->width - *dx;
+    if (*dy + *h > dst->height) *h = dst->height - *dy;
+    if (src != RT_NULL)
+    {
+        if (*sx < 0) { *dx -= *sx; *w += *sx; *sx = 0; }
+        if (*sy < 0) { *dy -= *sy; *h += *sy; *sy = 0; }
+        if (*sx + *w > src->width) *w = src->width - *sx;
+        if (*sy + *h > src->height) *h = src->height - *sy;
+    }
+    return *w > 0 && *h > 0;
+}
+
+int lcd_2d_surface(struct lcd_surface *surface, rt_device_t device)
+{
+    struct rt_device_graphic_info info;
+
+    if (device == RT_NULL) return -RT_ERROR;
+    if (rt_device_control(device, RTGRAPHIC_CTRL_GET_INFO, &info) != RT_EOK) return -RT_ERROR;
+
+    surface->pixels = info.framebuffer;
+    surface->width = info.width;
+    surface->height = info.height;
+    surface->pixel_format = info.pixel_format;
+    surface->pitch = info.width * (info.bits_per_pixel == 16 ? 2 : 4);
+    return RT_EOK;
+}
+
+void lcd_2d_fill(struct lcd_surface *dst, const struct rt_device_rect_info *rect, rt_uint32_t color)
+{
+    int x, y, w, h, sx = 0, sy = 0, row;
+    rt_uint8_t *d;
+
+    _g2d_rect(dst, rect, &x, &y, &w, &h);
+    if (!_g2d_clip(dst, &x, &y, RT_NULL, &sx, &sy, &w, &h)) return;
+
+    d = G2D_PIXEL(dst, x, y);
+    for (row = 0; row < h; row++, d += dst->pitch)
+        _fill_row(d, G2D_BPP(dst), color, w);
+}
+
+void lcd_2d_copy(struct lcd_surface *dst, int x, int y,
+    const struct lcd_surface *src, const struct rt_device_rect_info *rect)
+{
+    int sx, sy, w, h, row, len, dstep, sstep;
+    int bpp = G2D_BPP(dst);
+    rt_uint8_t *d;
+    const rt_uint8_t *s;
+
+    _g2d_rect(src, rect, &sx, &sy, &w, &h);
+    if (!_g2d_clip(dst, &x, &y, src, &sx, &sy, &w, &h)) return;
+
+    d = G2D_PIXEL(dst, x, y);
+    s = G2D_PIXEL(src, sx, sy);
+    if (bpp != G2D_BPP(src))
+    {
+        for (row = 0; row < h; row++, d += dst->pitch, s += src->pitch)
+            _convert_row(d, bpp, s, w);
+        return;
+    }
+
+    /* moving up in the same buffer has to start from the last line */
+    len = w * bpp;
+    dstep = dst->pitch;
+    sstep = src->pitch;
+    if (d > s)
+    {
+        d += (h - 1) * dst->pitch;
+        s += (h - 1) * src->pitch;
+        dstep = -dstep;
+        sstep = -sstep;
+    }
+    for (row = 0; row < h; row++, d += dstep, s += sstep)
+    {
+        if (d < s + len && s < d + len) rt_memmove(d, s, len);
+        else _copy_row(d, s, len);
+    }
+}
+
+void lcd_2d_blend(struct lcd_surface *dst, int x, int y,
+    const struct lcd_surface *src, const struct rt_device_rect_info *rect, int alpha)
+{
+    int sx, sy, w, h, row;
+    rt_uint8_t *d;
+    const rt_uint8_t *s;
+
+    if (src->pixel_format != RTGRAPHIC_PIXEL_FORMAT_ARGB888)
+    {
+        lcd_2d_copy(dst, x, y, src, rect);
+        return;
+    }
+    if (alpha <= 0) return;
+    if (alpha > 255) alpha = 255;
+
+    _g2d_rect(src, rect, &sx, &sy, &w, &h);
+    if (!_g2d_clip(dst, &x, &y, src, &sx, &sy, &w, &h)) return;
+
+    d = G2D_PIXEL(dst, x, y);
+    s = G2D_PIXEL(src, sx, sy);
+    for (row = 0; row < h; row++, d += dst->pitch, s += src->pitch)
+        _blend_row(d, G2D_BPP(dst), (const rt_uint32_t *)s, w, alpha);
+}
+
+/* plain c, a gather per pixel gains nothing from neon */
+void lcd_2d_scale(struct lcd_surface *dst, const struct rt_device_rect_info *dst_rect,
+    const struct lcd_surface *src, const struct rt_device_rect_info *src_rect)
+{
+    int dx, dy, dw, dh, sx, sy, sw, sh, x, y;
+    int dbpp = G2D_BPP(dst), sbpp = G2D_BPP(src);
+    rt_uint32_t stepx, stepy, fx0 = 0, fy0 = 0, fx;
+
+    _g2d_rect(dst, dst_rect, &dx, &dy, &dw, &dh);
+    _g2d_rect(src, src_rect, &sx, &sy, &sw, &sh);
+    if (sx + sw > src->width) sw = src->width - sx;
+    if (sy + sh > src->height) sh = src->height - sy;
+    if (dw <= 0 || dh <= 0 || sw <= 0 || sh <= 0) return;
+
+    stepx = ((rt_uint32_t)sw << 16) / dw;
+    stepy = ((rt_uint32_t)sh << 16) / dh;
+    if (dx < 0) { fx0 = -dx * stepx; dw += dx; dx = 0; }
+    if (dy < 0) { fy0 = -dy * stepy; dh += dy; dy = 0; }
+    if (dx + dw > dst->width) dw = dst->width - dx;
+    if (dy + dh > dst->height) dh = dst->height - dy;
+
+    for (y = 0; y < dh; y++)
+    {
+        const rt_uint8_t *s = G2D_PIXEL(src, sx, sy + ((fy0 + y * stepy) >> 16));
+        rt_uint8_t *d = G2D_PIXEL(dst, dx, dy + y);
+
+        fx = fx0;
+        if (dbpp == 2 && sbpp == 2)
+            for (x = 0; x < dw; x++, fx += stepx)
+                ((rt_uint16_t *)d)[x] = ((const rt_uint16_t *)s)[fx >> 16];
+        else if (dbpp == 4 && sbpp == 4)
+            for (x = 0; x < dw; x++, fx += stepx)
+                ((rt_uint32_t *)d)[x] = ((const rt_uint32_t *)s)[fx >> 16];
+        else if (dbpp == 4)
+            for (x = 0; x < dw; x++, fx += stepx)
+                ((rt_uint32_t *)d)[x] = _to_xrgb8888(((const rt_uint16_t *)s)[fx >> 16]);
+        else
+            for (x = 0; x < dw; x++, fx += stepx)
+                ((rt_uint16_t *)d)[x] = _to_rgb565(((const rt_uint32_t *)s)[fx >> 16]);
+    }
+}
+
+void lcd_2d_set_neon(int enable)
+{
+    _g2d_neon = enable;
+}
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#include <stdlib.h>
+extern unsigned long timer_get_us(void);
+
+#define G2D_BENCH_W     317     /* odd, so every row has a c tail */
+#define G2D_BENCH_H     120
+
+static const char *_bench_name[] =
+{
+    "fill 565", "fill 8888", "copy 8888", "copy overlap", "565 to 8888",
+    "8888 to 565", "blend 8888", "blend 565", "scale 8888",
+};
+
+static struct lcd_surface _bench_src16, _bench_src32, _bench_argb;
+
+static void _bench_op(int op, struct lcd_surface *dst)
+{
+    struct rt_device_rect_info rect;
+
+    rect.x = 5; rect.y = 3; rect.width = G2D_BENCH_W - 9; rect.height = G2D_BENCH_H - 7;
+    switch (op)
+    {
+    case 0:
+    case 1:
+        lcd_2d_fill(dst, &rect, 0x12345678);
+        break;
+    case 2:
+        lcd_2d_copy(dst, 3, 1, &_bench_src32, &rect);
+        break;
+    case 3:
+        lcd_2d_copy(dst, 9, 4, dst, &rect);
+        break;
+    case 4:
+        lcd_2d_copy(dst, 1, 2, &_bench_src16, RT_NULL);
+        break;
+    case 5:
+        lcd_2d_copy(dst, 1, 2, &_bench_argb, RT_NULL);
+        break;
+    case 6:
+    case 7:
+        lcd_2d_blend(dst, 2, 1, &_bench_argb, &rect, 200);
+        break;
+    case 8:
+        rect.x = 0; rect.y = 0; rect.width = G2D_BENCH_W / 2; rect.height = G2D_BENCH_H / 2;
+        lcd_2d_scale(dst, RT_NULL, &_bench_src32, &rect);
+        break;
+    }
+}
+
+static int _bench_surface(struct lcd_surface *s, int format)
+{
+    s->width = G2D_BENCH_W;
+    s->height = G2D_BENCH_H;
+    s->pixel_format = format;
+    s->pitch = G2D_BENCH_W * G2D_BPP(s);
+    s->pixels = rt_malloc(s->pitch * s->height);
+    return s->pixels != RT_NULL;
+}
+
+static void _bench_random(struct lcd_surface *s, rt_uint32_t seed)
+{
+    rt_uint32_t *p = (rt_uint32_t *)s->pixels;
+    int i;
+
+    for (i = 0; i < s->pitch * s->height / 4; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        p[i] = seed ^ (seed >> 16);
+    }
+}
+
+/*
+ * Every operation on both paths from the same random data. The results
+ * have to match pixel for pixel, then each path is timed.
+ */
+int lcd_2d_bench(int argc, char** argv)
+{
+    struct lcd_surface ref16, ref32, out[2];
+    int loops = 20, op, path, n, size, diff;
+    unsigned long us[2];
+
+    if (argc > 1) loops = atol(argv[1]);
+    if (loops <= 0) loops = 1;
+
+    rt_memset(&ref16, 0, sizeof(ref16));
+    rt_memset(&ref32, 0, sizeof(ref32));
+    rt_memset(out, 0, sizeof(out));
+    if (!_bench_surface(&_bench_src16, RTGRAPHIC_PIXEL_FORMAT_RGB565) ||
+        !_bench_surface(&_bench_src32, RTGRAPHIC_PIXEL_FORMAT_RGB888) ||
+        !_bench_surface(&_bench_argb, RTGRAPHIC_PIXEL_FORMAT_ARGB888) ||
+        !_bench_surface(&ref16, RTGRAPHIC_PIXEL_FORMAT_RGB565) ||
+        !_bench_surface(&ref32, RTGRAPHIC_PIXEL_FORMAT_RGB888) ||
+        !_bench_surface(&out[0], RTGRAPHIC_PIXEL_FORMAT_RGB888) ||
+        !_bench_surface(&out[1], RTGRAPHIC_PIXEL_FORMAT_RGB888))
+    {
+        rt_kprintf("no memory\n");
+        goto _exit;
+    }
+    _bench_random(&_bench_src16, 1);
+    _bench_random(&_bench_src32, 2);
+    _bench_random(&_bench_argb, 3);
+    _bench_random(&ref16, 4);
+    _bench_random(&ref32, 5);
+
+    rt_kprintf("%-12s %10s %10s\n", "op", "c us", "neon us");
+    for (op = 0; op < sizeof(_bench_name) / sizeof(_bench_name[0]); op++)
+    {
+        /* 565 destinations reuse the 32 bit buffers */
+        int bpp = (op == 0 || op == 5 || op == 7) ? 2 : 4;
+        struct lcd_surface *ref = bpp == 2 ? &ref16 : &ref32;
+
+        size = ref->pitch * ref->height;
+        for (path = 0; path < 2; path++)
+        {
+            out[path].pixel_format = ref->pixel_format;
+            out[path].pitch = ref->pitch;
+            lcd_2d_set_neon(path);
+            rt_memcpy(out[path].pixels, ref->pixels, size);
+            _bench_op(op, &out[path]);
+        }
+        for (diff = 0; diff < size; diff++)
+            if (((rt_uint8_t *)out[0].pixels)[diff] != ((rt_uint8_t *)out[1].pixels)[diff]) break;
+
+        for (path = 0; path < 2; path++)
+        {
+            lcd_2d_set_neon(path);
+            us[path] = timer_get_us();
+            for (n = 0; n < loops; n++) _bench_op(op, &out[path]);
+            us[path] = (timer_get_us() - us[path]) / loops;
+        }
+        rt_kprintf("%-12s %10d %10d", _bench_name[op], (int)us[0], (int)us[1]);
+        if (diff < size) rt_kprintf("  MISMATCH at pixel %d\n", diff / bpp);
+        else rt_kprintf("  ok\n");
+    }
+    lcd_2d_set_neon(1);
+
+_exit:
+    rt_free(_bench_src16.pixels);
+    rt_free(_bench_src32.pixels);
+    rt_free(_bench_argb.pixels);
+    rt_free(ref16.pixels);
+    rt_free(ref32.pixels);
+    rt_free(out[0].pixels);
+    rt_free(out[1].pixels);
+    rt_memset(&_bench_src16, 0, sizeof(_bench_src16));
+    rt_memset(&_bench_src32, 0, sizeof(_bench_src32));
+    rt_memset(&_bench_argb, 0, sizeof(_bench_argb));
+    return 0;
+}
+MSH_CMD_EXPORT(lcd_2d_bench, compare and time the c and neon 2d kernels);
+#endif
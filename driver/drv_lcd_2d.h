@@ -0,0 +1,61 @@
+/*
+ * File      : drv_lcd_2d.h
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef _DRV_LCD_2D_H_
+#define _DRV_LCD_2D_H_
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+/*
+ * A block of pixels: the lcd framebuffer, an overlay layer or any buffer
+ * in RTGRAPHIC_PIXEL_FORMAT_RGB565, RGB888 (x8r8g8b8) or ARGB888.
+ * Colors are passed as 0xaarrggbb. Every operation clips against the
+ * surfaces, a null rectangle means the whole source.
+ */
+struct lcd_surface
+{
+    void *pixels;
+    int pitch;              /* bytes per line */
+    int width;
+    int height;
+    int pixel_format;
+};
+
+int lcd_2d_surface(struct lcd_surface *surface, rt_device_t device);
+
+void lcd_2d_fill(struct lcd_surface *dst, const struct rt_device_rect_info *rect, rt_uint32_t color);
+/* converts between formats, overlapping areas of one buffer are fine */
+void lcd_2d_copy(struct lcd_surface *dst, int x, int y,
+    const struct lcd_surface *src, const struct rt_device_rect_info *rect);
+/* src over dst with the source alpha times alpha (0..255), src is ARGB888 */
+void lcd_2d_blend(struct lcd_surface *dst, int x, int y,
+    const struct lcd_surface *src, const struct rt_device_rect_info *rect, int alpha);
+/* nearest neighbour */
+void lcd_2d_scale(struct lcd_surface *dst, const struct rt_device_rect_info *dst_rect,
+    const struct lcd_surface *src, const struct rt_device_rect_info *src_rect);
+
+/* 1 uses the neon kernels (default), 0 the c ones */
+void lcd_2d_set_neon(int enable);
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * File      : drv_spi.h
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef _DRV_SPI_H_
+#define _DRV_SPI_H_
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+typedef void (*spi_async_done_t)(struct rt_spi_device *device, struct rt_spi_message *message, void *param);
+
+/*
+ * One queued message chain. The structure and the messages belong to the
+ * caller and must stay valid until done() is called, which happens in
+ * interrupt context.
+ */
+struct spi_async
+{
+    struct rt_spi_device *device;
+    struct rt_spi_message *message;
+    spi_async_done_t done;
+    void *param;
+
+    struct spi_async *next;
+};
+
+rt_err_t rt_hw_spi_async_submit(struct spi_async *xfer);
+rt_err_t rt_hw_spi_device_attach(const char *bus_name, const char *device_name, uint32_t cs_pin);
+
+#endif
@@ -0,0 +1,362 @@
+/*
+ * File      : drv_spi_lcd.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+
+#include "board.h"
+#include "drv_spi.h"
+#include "drv_spi_lcd.h"
+
+/* st7789 class panel, 4-wire spi with a data/command line */
+#ifndef SPI_LCD_WIDTH
+#define SPI_LCD_WIDTH       240
+#endif
+#ifndef SPI_LCD_HEIGHT
+#define SPI_LCD_HEIGHT      240
+#endif
+#ifndef SPI_LCD_CS_PIN
+#define SPI_LCD_CS_PIN      SUNXI_GPB(4)
+#endif
+#ifndef SPI_LCD_DC_PIN
+#define SPI_LCD_DC_PIN      SUNXI_GPB(5)
+#endif
+#ifndef SPI_LCD_RST_PIN
+#define SPI_LCD_RST_PIN     SUNXI_GPB(6)
+#endif
+#define SPI_LCD_MAX_HZ      (24 * 1000 * 1000)
+
+#define ST7789_SWRESET      0x01
+#define ST7789_SLPOUT       0x11
+#define ST7789_NORON        0x13
+#define ST7789_INVON        0x21
+#define ST7789_DISPON       0x29
+#define ST7789_CASET        0x2a
+#define ST7789_RASET        0x2b
+#define ST7789_RAMWR        0x2c
+#define ST7789_MADCTL       0x36
+#define ST7789_COLMOD       0x3a
+
+struct spilcd_device
+{
+    struct rt_device device;
+    struct rt_device_graphic_info info;
+    const struct spilcd_ops *ops;
+    void *priv;
+
+    /* dirty rectangle converted to panel byte order, streamed by the transport */
+    rt_uint8_t *txbuf;
+    struct rt_semaphore done;
+};
+
+static void _spilcd_window(struct spilcd_device *lcd, int x, int y, int w, int h)
+{
+    rt_uint8_t buf[4];
+
+    buf[0] = x >> 8; buf[1] = x; buf[2] = (x+w-1) >> 8; buf[3] = x+w-1;
+    lcd->ops->cmd(lcd->priv, ST7789_CASET, buf, 4);
+    buf[0] = y >> 8; buf[1] = y; buf[2] = (y+h-1) >> 8; buf[3] = y+h-1;
+    lcd->ops->cmd(lcd->priv, ST7789_RASET, buf, 4);
+    lcd->ops->cmd(lcd->priv, ST7789_RAMWR, RT_NULL, 0);
+}
+
+static void _spilcd_done(void *param)
+{
+    struct spilcd_device *lcd = (struct spilcd_device *)param;
+    rt_sem_release(&lcd->done);
+}
+
+/* the last rectangle is out, the panel shows the framebuffer */
+static void _spilcd_wait(struct spilcd_device *lcd)
+{
+    rt_sem_take(&lcd->done, RT_WAITING_FOREVER);
+    rt_sem_release(&lcd->done);
+}
+
+/* send only the dirty rectangle, the panel keeps everything else */
+static void _spilcd_update(struct spilcd_device *lcd, struct rt_device_rect_info *rect)
+{
+    int x = 0, y = 0, w = lcd->info.width, h = lcd->info.height;
+    int row, col;
+
+    if (rect != RT_NULL)
+    {
+        x = rect->x; y = rect->y; w = rect->width; h = rect->height;
+        if (x >= lcd->info.width || y >= lcd->info.height) return;
+        if (x + w > lcd->info.width) w = lcd->info.width - x;
+        if (y + h > lcd->info.height) h = lcd->info.height - y;
+    }
+    if (w <= 0 || h <= 0) return;
+
+    /* the previous rectangle may still be on the wire */
+    rt_sem_take(&lcd->done, RT_WAITING_FOREVER);
+
+    /* the panel wants big endian rgb565 */
+    for (row = 0; row < h; row++)
+    {
+        const rt_uint16_t *src = (const rt_uint16_t *)lcd->info.framebuffer + (y+row) * lcd->info.width + x;
+        rt_uint8_t *dst = lcd->txbuf + row * w * 2;
+        for (col = 0; col < w; col++)
+        {
+            *dst++ = src[col] >> 8;
+            *dst++ = src[col];
+        }
+    }
+
+    _spilcd_window(lcd, x, y, w, h);
+    if (lcd->ops->pixels(lcd->priv, lcd->txbuf, w * h * 2, _spilcd_done, lcd) != RT_EOK)
+        rt_sem_release(&lcd->done);
+}
+
+static rt_err_t _spilcd_init(rt_device_t device)
+{
+    return RT_EOK;
+}
+
+static rt_err_t _spilcd_control(rt_device_t device, int cmd, void *args)
+{
+    struct spilcd_device *lcd = (struct spilcd_device *)device;
+    RT_ASSERT(lcd != RT_NULL);
+
+    switch(cmd)
+    {
+    case RTGRAPHIC_CTRL_GET_INFO:
+        rt_memcpy(args, &lcd->info, sizeof(lcd->info));
+        break;
+    case RTGRAPHIC_CTRL_RECT_UPDATE:
+        _spilcd_update(lcd, (struct rt_device_rect_info *)args);
+        break;
+    }
+
+    return RT_EOK;
+}
+
+/**
+ * Bring up a panel behind ops and register it as a graphic device. The
+ * panel must be out of hardware reset, the rest of its setup goes through
+ * ops like everything after it.
+ */
+rt_err_t rt_hw_spi_lcd_register(const char *name, const struct spilcd_ops *ops, void *priv,
+    int width, int height)
+{
+    struct spilcd_device *lcd;
+    rt_uint8_t val;
+
+    lcd = rt_malloc(sizeof(struct spilcd_device));
+    if (lcd == RT_NULL) return -RT_ENOMEM;
+    rt_memset(lcd, 0, sizeof(struct spilcd_device));
+    lcd->ops = ops;
+    lcd->priv = priv;
+
+    ops->cmd(priv, ST7789_SWRESET, RT_NULL, 0);
+    rt_thread_delay(RT_TICK_PER_SECOND * 150 / 1000);
+    ops->cmd(priv, ST7789_SLPOUT, RT_NULL, 0);
+    rt_thread_delay(RT_TICK_PER_SECOND * 120 / 1000);
+    val = 0x55;     /* 16 bit rgb565 */
+    ops->cmd(priv, ST7789_COLMOD, &val, 1);
+    val = 0x00;
+    ops->cmd(priv, ST7789_MADCTL, &val, 1);
+    ops->cmd(priv, ST7789_INVON, RT_NULL, 0);
+    ops->cmd(priv, ST7789_NORON, RT_NULL, 0);
+    ops->cmd(priv, ST7789_DISPON, RT_NULL, 0);
+
+    lcd->info.width = width;
+    lcd->info.height = height;
+    lcd->info.bits_per_pixel = 16;
+    lcd->info.pixel_format = RTGRAPHIC_PIXEL_FORMAT_RGB565;
+    lcd->info.framebuffer = rt_malloc(width * height * 2);
+    lcd->txbuf = rt_malloc(width * height * 2);
+    if (lcd->info.framebuffer == RT_NULL || lcd->txbuf == RT_NULL)
+    {
+        rt_free(lcd->info.framebuffer);
+        rt_free(lcd->txbuf);
+        rt_free(lcd);
+        return -RT_ENOMEM;
+    }
+    rt_memset(lcd->info.framebuffer, 0, width * height * 2);
+    rt_sem_init(&lcd->done, name, 1, RT_IPC_FLAG_FIFO);
+
+    lcd->device.type    = RT_Device_Class_Graphic;
+    lcd->device.init    = _spilcd_init;
+    lcd->device.open    = RT_NULL;
+    lcd->device.close   = RT_NULL;
+    lcd->device.read    = RT_NULL;
+    lcd->device.write   = RT_NULL;
+    lcd->device.control = _spilcd_control;
+    rt_device_register(&lcd->device, name, RT_DEVICE_FLAG_RDWR);
+
+    _spilcd_update(lcd, RT_NULL);
+
+    return RT_EOK;
+}
+
+/* the spi transport, pixels go out through the spi message queue */
+struct spilcd_spi
+{
+    struct rt_spi_device *spi;
+    struct rt_spi_message msg;
+    struct spi_async xfer;
+    void (*done)(void *param);
+    void *param;
+};
+
+static void _spilcd_spi_cmd(void *priv, rt_uint8_t cmd, const void *data, int len)
+{
+    struct spilcd_spi *spi = (struct spilcd_spi *)priv;
+
+    gpio_set_value(SPI_LCD_DC_PIN, 0);
+    rt_spi_send(spi->spi, &cmd, 1);
+    if (len > 0)
+    {
+        gpio_set_value(SPI_LCD_DC_PIN, 1);
+        rt_spi_send(spi->spi, data, len);
+    }
+}
+
+static void _spilcd_spi_done(struct rt_spi_device *device, struct rt_spi_message *message, void *param)
+{
+    struct spilcd_spi *spi = (struct spilcd_spi *)param;
+    spi->done(spi->param);
+}
+
+static rt_err_t _spilcd_spi_pixels(void *priv, const void *buf, int len, void (*done)(void *param), void *param)
+{
+    struct spilcd_spi *spi = (struct spilcd_spi *)priv;
+
+    gpio_set_value(SPI_LCD_DC_PIN, 1);
+
+    spi->done           = done;
+    spi->param          = param;
+    spi->msg.send_buf   = buf;
+    spi->msg.recv_buf   = RT_NULL;
+    spi->msg.length     = len;
+    spi->msg.cs_take    = 1;
+    spi->msg.cs_release = 1;
+    spi->msg.next       = RT_NULL;
+    spi->xfer.device    = spi->spi;
+    spi->xfer.message   = &spi->msg;
+    spi->xfer.done      = _spilcd_spi_done;
+    spi->xfer.param     = spi;
+    return rt_hw_spi_async_submit(&spi->xfer);
+}
+
+static const struct spilcd_ops _spilcd_spi_ops =
+{
+    _spilcd_spi_cmd,
+    _spilcd_spi_pixels,
+};
+
+static struct spilcd_spi spilcd_spi;
+int rt_hw_spi_lcd_init(void)
+{
+    struct rt_spi_configuration cfg;
+
+    if (rt_hw_spi_device_attach("spi", "st7789", SPI_LCD_CS_PIN) != RT_EOK)
+        return -1;
+    spilcd_spi.spi = (struct rt_spi_device *)rt_device_find("st7789");
+    if (spilcd_spi.spi == RT_NULL) return -1;
+
+    cfg.data_width = 8;
+    cfg.mode = RT_SPI_MODE_0 | RT_SPI_MSB;
+    cfg.max_hz = SPI_LCD_MAX_HZ;
+    rt_spi_configure(spilcd_spi.spi, &cfg);
+
+    gpio_set_mode(SPI_LCD_DC_PIN, PIN_TYPE(SUNXI_GPIO_OUTPUT)|PULL_UP);
+    gpio_set_mode(SPI_LCD_RST_PIN, PIN_TYPE(SUNXI_GPIO_OUTPUT)|PULL_UP);
+    gpio_set_value(SPI_LCD_RST_PIN, 0);
+    rt_thread_delay(RT_TICK_PER_SECOND / 100);
+    gpio_set_value(SPI_LCD_RST_PIN, 1);
+    rt_thread_delay(RT_TICK_PER_SECOND * 120 / 1000);
+
+    if (rt_hw_spi_lcd_register("spilcd", &_spilcd_spi_ops, &spilcd_spi,
+        SPI_LCD_WIDTH, SPI_LCD_HEIGHT) != RT_EOK)
+        return -1;
+
+    return 0;
+}
+INIT_DEVICE_EXPORT(rt_hw_spi_lcd_init);
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#include <stdlib.h>
+
+/* frames rectangles of w x h moving over the panel, frames per second */
+static rt_uint32_t _spilcd_bench_run(struct spilcd_device *lcd, int frames, int w, int h)
+{
+    struct rt_device_rect_info rect;
+    rt_uint16_t *fb = (rt_uint16_t *)lcd->info.framebuffer;
+    rt_uint64_t t0, us;
+    int i;
+
+    rect.width = w;
+    rect.height = h;
+    _spilcd_wait(lcd);
+    t0 = get_ticks();
+    for (i = 0; i < frames; i++)
+    {
+        rect.x = (i * 7) % (lcd->info.width - w + 1);
+        rect.y = (i * 5) % (lcd->info.height - h + 1);
+        fb[rect.y * lcd->info.width + rect.x] = i;
+        _spilcd_control(&lcd->device, RTGRAPHIC_CTRL_RECT_UPDATE, &rect);
+    }
+    _spilcd_wait(lcd);
+    us = (get_ticks() - t0) / 24;
+
+    return us ? (rt_uint32_t)(frames * 1000000ULL * 10 / us) : 0;
+}
+
+static void _spilcd_bench_show(const char *name, int w, int h, rt_uint32_t fps10)
+{
+    /* what the spi clock alone would allow, 16 bit pixels */
+    rt_uint32_t wire10 = (rt_uint32_t)(SPI_LCD_MAX_HZ * 10ULL / (w * h * 16));
+
+    rt_kprintf("%-8s %3dx%-3d %5d.%d fps, wire limit %5d.%d fps\n", name, w, h,
+        fps10 / 10, fps10 % 10, wire10 / 10, wire10 % 10);
+}
+
+/* full screen and partial window update rate, conversion and spi included */
+int spilcd_bench(int argc, char **argv)
+{
+    struct spilcd_device *lcd;
+    int frames = 100, w, h;
+
+    if (argc > 1) frames = atol(argv[1]);
+    if (frames <= 0) frames = 100;
+    lcd = (struct spilcd_device *)rt_device_find(argc > 2 ? argv[2] : "spilcd");
+    if (lcd == RT_NULL || lcd->device.control != _spilcd_control)
+    {
+        rt_kprintf("no spi lcd\n");
+        return -1;
+    }
+
+    w = lcd->info.width;
+    h = lcd->info.height;
+    _spilcd_bench_show("full", w, h, _spilcd_bench_run(lcd, frames, w, h));
+    _spilcd_bench_show("partial", w / 4, h / 4, _spilcd_bench_run(lcd, frames, w / 4, h / 4));
+    _spilcd_bench_show("partial", w / 2, h / 2, _spilcd_bench_run(lcd, frames, w / 2, h / 2));
+
+    return 0;
+}
+MSH_CMD_EXPORT(spilcd_bench, spi lcd full screen and partial window fps: [frames] [device]);
+#endif
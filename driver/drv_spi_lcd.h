@@ -0,0 +1,47 @@
+/*
+ * File      : drv_spi_lcd.h
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef _DRV_SPI_LCD_H_
+#define _DRV_SPI_LCD_H_
+
+#include <rtthread.h>
+
+/*
+ * How the st7789 driver reaches its panel. drv_spi_lcd.c brings the spi
+ * transport; anything else that takes a command stream and a pixel
+ * stream, such as a framebuffer sink on the host, can register a panel
+ * of its own with rt_hw_spi_lcd_register and sees exactly what the
+ * panel would.
+ */
+struct spilcd_ops
+{
+    /* a command byte with dc low, then len parameter bytes with dc high */
+    void (*cmd)(void *priv, rt_uint8_t cmd, const void *data, int len);
+    /* len bytes of big endian rgb565 with dc high, done(param) once they are out */
+    rt_err_t (*pixels)(void *priv, const void *buf, int len, void (*done)(void *param), void *param);
+};
+
+rt_err_t rt_hw_spi_lcd_register(const char *name, const struct spilcd_ops *ops, void *priv,
+    int width, int height);
+
+#endif
@@ -240,6 +240,58 @@ struct de_ui {
 	u32 ovl_size;			/* 88 */
 };
 
+/* video scaler, one per vi channel */
+struct de_vsu {
+	u32 ctrl;			/* 000 */
+	u32 dum0[15];
+	u32 outsize;			/* 040 */
+	u32 dum1[15];
+	u32 y_insize;			/* 080 */
+	u32 dum2;
+	u32 y_hstep;			/* 088 */
+	u32 y_vstep;
+	u32 y_hphase;			/* 090 */
+	u32 dum3;
+	u32 y_vphase[2];		/* 098 */
+	u32 dum4[8];
+	u32 c_insize;			/* 0c0 */
+	u32 dum5;
+	u32 c_hstep;			/* 0c8 */
+	u32 c_vstep;
+	u32 c_hphase;			/* 0d0 */
+	u32 dum6;
+	u32 c_vphase[2];		/* 0d8 */
+	u32 dum7[72];
+	u32 y_hcoef0[32];		/* 200 */
+	u32 dum8[32];
+	u32 y_hcoef1[32];		/* 300 */
+	u32 dum9[32];
+	u32 y_vcoef[32];		/* 400 */
+	u32 dum10[96];
+	u32 c_hcoef0[32];		/* 600 */
+	u32 dum11[32];
+	u32 c_hcoef1[32];		/* 700 */
+	u32 dum12[32];
+	u32 c_vcoef[32];		/* 800 */
+};
+
+/* ui scaler, one per ui channel */
+struct de_gsu {
+	u32 ctrl;			/* 000 */
+	u32 dum0[15];
+	u32 outsize;			/* 040 */
+	u32 dum1[15];
+	u32 insize;			/* 080 */
+	u32 dum2;
+	u32 hstep;			/* 088 */
+	u32 vstep;
+	u32 hphase;			/* 090 */
+	u32 dum3;
+	u32 vphase;			/* 098 */
+	u32 dum4[89];
+	u32 hcoef[16];			/* 200 */
+};
+
 struct sunxi_lcdc_reg {
 	u32 ctrl;			/* 0x00 */
 	u32 int0;			/* 0x04 */
@@ -460,12 +512,40 @@ struct sunxi_tve_reg {
 
 #define SUNXI_DE2_MUX_GLB_CTL_RT_EN		(1 << 0)
 
+/* mixer0 has the vi channels first, then the ui ones */
+#ifdef CONFIG_MACH_SUN8I_V3S
+#define SUNXI_DE2_MUX_VI_NUM			2
+#define SUNXI_DE2_MUX_UI_NUM			1
+#else
+#define SUNXI_DE2_MUX_VI_NUM			1
+#define SUNXI_DE2_MUX_UI_NUM			3
+#endif
+#define SUNXI_DE2_MUX_CHAN_NUM			(SUNXI_DE2_MUX_VI_NUM + \
+						 SUNXI_DE2_MUX_UI_NUM)
+
+/* scalers follow the channel order, vi ones are twice as large */
+#define SUNXI_DE2_MUX_SCALER_REGS		0x20000
+#define SUNXI_DE2_MUX_VSU_SZ			0x20000
+#define SUNXI_DE2_MUX_GSU_SZ			0x10000
+#define SUNXI_DE2_SCALER_CTRL_EN		(1 << 0)
+#define SUNXI_DE2_SCALER_CTRL_COEF_SWITCH	(1 << 4)
+#define SUNXI_DE2_SCALER_STEP_FRAC		20
+
+#define SUNXI_DE2_VI_CFG_ATTR_EN		(1 << 0)
+#define SUNXI_DE2_VI_CFG_ATTR_FMT(f)		((f & 0x1f) << 8)
+#define SUNXI_DE2_VI_CFG_ATTR_UI_SEL		(1 << 15)
+
 #define SUNXI_DE2_UI_CFG_ATTR_EN		(1 << 0)
 #define SUNXI_DE2_UI_CFG_ATTR_ALPMOD(m)		((m & 3) << 1)
 #define SUNXI_DE2_UI_CFG_ATTR_FMT(f)		((f & 0xf) << 8)
 #define SUNXI_DE2_UI_CFG_ATTR_ALPHA(a)		((a & 0xff) << 24)
 
 #define SUNXI_DE2_WH(w, h)			(((h - 1) << 16) | (w - 1))
+#define SUNXI_DE2_XY(x, y)			(((y) << 16) | (x))
+
+#define SUNXI_DE2_BLD_FCOLOR_EN(p)		(1 << (p))
+#define SUNXI_DE2_BLD_PIPE_EN(p)		(1 << ((p) + 8))
+#define SUNXI_DE2_BLD_ROUTE(p, ch)		(((ch) & 0xf) << ((p) * 4))
 
 /*
  * LCDC register constants.
@@ -478,6 +558,14 @@ struct sunxi_tve_reg {
 #define SUNXI_LCDC_CTRL_IO_MAP_TCON0		(0 << 0)
 #define SUNXI_LCDC_CTRL_IO_MAP_TCON1		(1 << 0)
 #define SUNXI_LCDC_CTRL_TCON_ENABLE		(1 << 31)
+#define SUNXI_LCDC_INT0_TCON0_VB_ENABLE		(1 << 31)
+#define SUNXI_LCDC_INT0_TCON1_VB_ENABLE		(1 << 30)
+#define SUNXI_LCDC_INT0_TCON0_VB_FLAG		(1 << 15)
+#define SUNXI_LCDC_INT0_TCON1_VB_FLAG		(1 << 14)
+#define SUNXI_LCDC_INT0_TCON0_LINE_FLAG		(1 << 13)
+#define SUNXI_LCDC_INT0_TCON1_LINE_FLAG		(1 << 12)
+#define SUNXI_LCDC_INT1_TCON0_LINE(n)		(((n) & 0xfff) << 16)
+#define SUNXI_LCDC_INT1_TCON1_LINE(n)		(((n) & 0xfff) << 0)
 #define SUNXI_LCDC_TCON0_FRM_CTRL_RGB666	((1 << 31) | (0 << 4))
 #define SUNXI_LCDC_TCON0_FRM_CTRL_RGB565	((1 << 31) | (5 << 4))
 #define SUNXI_LCDC_TCON0_FRM_SEED		0x11111111
@@ -47,6 +47,12 @@ struct sunxi_spi_regs {
 
 #define SUNXI_SPI_CTL_RF_RST		BIT(15)
 #define SUNXI_SPI_CTL_TF_RST		BIT(31)
+#define SUNXI_SPI_CTL_RF_TRIG(lvl)	((lvl) & 0xff)
+#define SUNXI_SPI_CTL_TF_TRIG(lvl)	(((lvl) & 0xff) << 16)
+
+#define SUNXI_SPI_INT_RF_RDY		BIT(0)
+#define SUNXI_SPI_INT_TF_ERQ		BIT(4)
+#define SUNXI_SPI_INT_TC		BIT(12)
 
 #define SUNXI_SPI_FIFO_RF_CNT_MASK	0x7f
 #define SUNXI_SPI_FIFO_RF_CNT_BITS	0
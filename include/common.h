@@ -692,6 +692,10 @@ ulong	get_timer	   (ulong base);
 /* Return value of monotonic microsecond timer */
 unsigned long timer_get_us(void);
 
+/* 64-bit microsecond and nanosecond time since boot, never wrap */
+uint64_t timer_get_boot_us(void);
+uint64_t timer_get_ns(void);
+
 void	enable_interrupts  (void);
 int	disable_interrupts (void);
 
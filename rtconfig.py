@@ -33,7 +33,7 @@ if PLATFORM == 'gcc':
     OBJDUMP = PREFIX + 'objdump'
     OBJCPY  = PREFIX + 'objcopy'
 
-    DEVICE  = ' -march=armv7-a -mtune=cortex-a7 -ftree-vectorize -ffast-math -mfloat-abi=softfp -msoft-float'
+    DEVICE  = ' -march=armv7-a -mtune=cortex-a7 -ftree-vectorize -ffast-math -mfpu=neon-vfpv4 -mfloat-abi=softfp'
     DEVICE += ' -ffunction-sections -fdata-sections -fno-common -mno-unaligned-access -DCONFIG_USE_STDINT'
     DEVICE += ' -Iinclude -D__KERNEL__ -D__UBOOT__ -D__ARM__ -D__LINUX_ARM_ARCH__=7 -include include/linux/kconfig.h'
     CFLAGS  = DEVICE + ' -Wall -Wno-unused-function -Wno-unused-variable -Wno-unused-but-set-variable' 
@@ -70,6 +70,13 @@ const struct ctfb_res_modes composite_video_modes[2] = {
 	{ 720,  480, 60, 37037,  27000, 116,  20, 16, 27,   2, 2, 0, FB_VMODE_INTERLACED },
 };
 
+/*
+ * What tells one display from another: the header, vendor, product and
+ * serial number at the start of edid block 0, and its checksum.
+ */
+#define SUNXI_EDID_IDENT_LEN	16
+#define SUNXI_EDID_IDENT_WORDS	(SUNXI_EDID_IDENT_LEN / 4 + 1)
+
 #ifdef CONFIG_VIDEO_HDMI
 
 /*
@@ -205,17 +212,12 @@ static int sunxi_hdmi_edid_get_block(int block, u8 *buf)
 	return r;
 }
 
-static int sunxi_hdmi_edid_get_mode(struct ctfb_res_modes *mode)
+static int sunxi_hdmi_ddc_enable(void)
 {
-	struct edid1_info edid1;
-	struct edid_cea861_info cea681[4];
-	struct edid_detailed_timing *t =
-		(struct edid_detailed_timing *)edid1.monitor_details.timing;
 	struct sunxi_hdmi_reg * const hdmi =
 		(struct sunxi_hdmi_reg *)SUNXI_HDMI_BASE;
 	struct sunxi_ccm_reg * const ccm =
 		(struct sunxi_ccm_reg *)SUNXI_CCM_BASE;
-	int i, r, ext_blocks = 0;
 
 	/* SUNXI_HDMI_CTRL_ENABLE & PAD_CTRL0 are already set by hpd_detect */
 	writel(SUNXI_HDMI_PAD_CTRL1 | SUNXI_HDMI_PAD_CTRL1_HALVE,
@@ -238,8 +240,56 @@ static int sunxi_hdmi_edid_get_mode(struct ctfb_res_modes *mode)
 	writel(SUNXI_HMDI_DDC_LINE_CTRL_SDA_ENABLE |
 	       SUNXI_HMDI_DDC_LINE_CTRL_SCL_ENABLE, &hdmi->ddc_line_ctrl);
 #endif
+	return 0;
+}
+
+static void sunxi_hdmi_ddc_disable(void)
+{
+	struct sunxi_hdmi_reg * const hdmi =
+		(struct sunxi_hdmi_reg *)SUNXI_HDMI_BASE;
+	struct sunxi_ccm_reg * const ccm =
+		(struct sunxi_ccm_reg *)SUNXI_CCM_BASE;
+
+	clrbits_le32(&hdmi->ddc_ctrl, SUNXI_HMDI_DDC_CTRL_ENABLE);
+	clrbits_le32(&ccm->hdmi_clk_cfg, CCM_HDMI_CTRL_DDC_GATE);
+}
+
+static void sunxi_hdmi_edid_ident(const u8 *block, u32 *ident)
+{
+	memcpy(ident, block, SUNXI_EDID_IDENT_LEN);
+	ident[SUNXI_EDID_IDENT_WORDS - 1] = block[127];
+}
+
+/* Read only edid block 0, enough to recognise a cached display */
+static int sunxi_hdmi_edid_get_ident(u32 *ident)
+{
+	u8 block[128];
+	int r;
+
+	r = sunxi_hdmi_ddc_enable();
+	if (r == 0)
+		r = sunxi_hdmi_edid_get_block(0, block);
+	sunxi_hdmi_ddc_disable();
+	if (r == 0)
+		sunxi_hdmi_edid_ident(block, ident);
+	return r;
+}
+
+static int sunxi_hdmi_edid_get_mode(struct ctfb_res_modes *mode, u32 *ident)
+{
+	struct edid1_info edid1;
+	struct edid_cea861_info cea681[4];
+	struct edid_detailed_timing *t =
+		(struct edid_detailed_timing *)edid1.monitor_details.timing;
+	int i, r, ext_blocks = 0;
+
+	r = sunxi_hdmi_ddc_enable();
+	if (r)
+		return r;
 
 	r = sunxi_hdmi_edid_get_block(0, (u8 *)&edid1);
+	if (r == 0)
+		sunxi_hdmi_edid_ident((u8 *)&edid1, ident);
 	if (r == 0) {
 		r = edid_check_info(&edid1);
 		if (r) {
@@ -261,8 +311,7 @@ static int sunxi_hdmi_edid_get_mode(struct ctfb_res_modes *mode)
 	}
 
 	/* Disable DDC engine, no longer needed */
-	clrbits_le32(&hdmi->ddc_ctrl, SUNXI_HMDI_DDC_CTRL_ENABLE);
-	clrbits_le32(&ccm->hdmi_clk_cfg, CCM_HDMI_CTRL_DDC_GATE);
+	sunxi_hdmi_ddc_disable();
 
 	if (r)
 		return r;
@@ -546,6 +595,16 @@ static void sunxi_composer_init(void)
 	setbits_le32(&ccm->de_clk_cfg, CCM_DE2_CTRL_GATE);
 }
 
+static void *sunxi_composer_scaler_base(int channel)
+{
+	if (channel < SUNXI_DE2_MUX_VI_NUM)
+		return SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_SCALER_REGS +
+			SUNXI_DE2_MUX_VSU_SZ * channel;
+	return SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_SCALER_REGS +
+		SUNXI_DE2_MUX_VSU_SZ * SUNXI_DE2_MUX_VI_NUM +
+		SUNXI_DE2_MUX_GSU_SZ * (channel - SUNXI_DE2_MUX_VI_NUM);
+}
+
 static void sunxi_composer_mode_set(const struct ctfb_res_modes *mode,
 				    unsigned int address)
 {
@@ -577,10 +636,10 @@ static void sunxi_composer_mode_set(const struct ctfb_res_modes *mode,
 	writel(1, &de_glb_regs->dbuff);
 	writel(size, &de_glb_regs->size);
 
-	for (channel = 0; channel < 4; channel++) {
+	for (channel = 0; channel < SUNXI_DE2_MUX_CHAN_NUM; channel++) {
 		void *chan = SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_CHAN_REGS +
 			SUNXI_DE2_MUX_CHAN_SZ * channel;
-		memset(chan, 0, channel == 0 ?
+		memset(chan, 0, channel < SUNXI_DE2_MUX_VI_NUM ?
 			sizeof(struct de_vi) : sizeof(struct de_ui));
 	}
 	memset(de_bld_regs, 0, sizeof(struct de_bld));
@@ -592,8 +651,9 @@ static void sunxi_composer_mode_set(const struct ctfb_res_modes *mode,
 	writel(0, &de_bld_regs->premultiply);
 	writel(0xff000000, &de_bld_regs->bkcolor);
 
-	writel(0x03010301, &de_bld_regs->bld_mode[0]);
-	writel(0x03010301, &de_bld_regs->bld_mode[1]);
+	/* source over for every pipe, overlay layers may use them all */
+	for (i = 0; i < 4; i++)
+		writel(0x03010301, &de_bld_regs->bld_mode[i]);
 
 	writel(size, &de_bld_regs->output_size);
 	writel(mode->vmode & FB_VMODE_INTERLACED ? 2 : 0,
@@ -606,10 +666,8 @@ static void sunxi_composer_mode_set(const struct ctfb_res_modes *mode,
 	}
 
 	/* Disable all other units */
-	writel(0, SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_VSU_REGS);
-	writel(0, SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_GSU1_REGS);
-	writel(0, SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_GSU2_REGS);
-	writel(0, SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_GSU3_REGS);
+	for (channel = 0; channel < SUNXI_DE2_MUX_CHAN_NUM; channel++)
+		writel(0, sunxi_composer_scaler_base(channel));
 	writel(0, SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_FCE_REGS);
 	writel(0, SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_BWS_REGS);
 	writel(0, SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_LTI_REGS);
@@ -651,6 +709,274 @@ void sunxi_composer_fbbase_set(void* fbbase)
 	writel(address, &de_ui_regs->cfg[0].top_laddr);
 	sunxi_composer_enable();
 }
+
+/*
+ * The mixer registers are double buffered, dbuff stays set until the
+ * new values have been latched at the start of a frame.
+ */
+int sunxi_composer_fbbase_pending(void)
+{
+	struct de_glb * const de_glb_regs =
+		(struct de_glb *)(SUNXI_DE2_MUX0_BASE +
+				  SUNXI_DE2_MUX_GLB_REGS);
+
+	return readl(&de_glb_regs->dbuff) & 1;
+}
+
+/*
+ * Overlay layers. Every mixer channel is one layer and goes through one
+ * blender pipe, the pipe number is the z-order (pipe 0 at the bottom) and
+ * holds the position on screen. The framebuffer set up above is channel 2
+ * on pipe 0. Nothing takes effect before sunxi_composer_commit().
+ */
+int sunxi_composer_channels(int *primary)
+{
+	if (primary)
+		*primary = 2;
+	return SUNXI_DE2_MUX_CHAN_NUM;
+}
+
+static u32 sunxi_composer_format(int depth)
+{
+	switch (depth) {
+	case 16:
+		return SUNXI_DE2_FORMAT_RGB_565;
+	case 24:
+		return SUNXI_DE2_FORMAT_XRGB_8888;
+	default:
+		return SUNXI_DE2_FORMAT_ARGB_8888;
+	}
+}
+
+/* depth 16 is rgb565, 24 is xrgb8888 and 32 argb8888 */
+int sunxi_composer_layer_set(int channel, int depth, void *fbbase,
+			     int pitch, int width, int height, int alpha)
+{
+	void *chan = SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_CHAN_REGS +
+		SUNXI_DE2_MUX_CHAN_SZ * channel;
+	unsigned int address = (unsigned int)fbbase - CONFIG_SYS_SDRAM_BASE;
+	u32 size = SUNXI_DE2_WH(width, height);
+	u32 fmt = sunxi_composer_format(depth);
+
+	if (channel < 0 || channel >= SUNXI_DE2_MUX_CHAN_NUM)
+		return -EINVAL;
+
+	if (channel < SUNXI_DE2_MUX_VI_NUM) {
+		struct de_vi * const de_vi_regs = chan;
+
+		/* DE2.0 vi channels only know per pixel alpha */
+		writel(SUNXI_DE2_VI_CFG_ATTR_EN |
+		       SUNXI_DE2_VI_CFG_ATTR_UI_SEL |
+		       SUNXI_DE2_VI_CFG_ATTR_FMT(fmt),
+		       &de_vi_regs->cfg[0].attr);
+		writel(size, &de_vi_regs->cfg[0].size);
+		writel(0, &de_vi_regs->cfg[0].coord);
+		writel(pitch, &de_vi_regs->cfg[0].pitch[0]);
+		writel(address, &de_vi_regs->cfg[0].top_laddr[0]);
+		writel(size, &de_vi_regs->ovl_size[0]);
+	} else {
+		struct de_ui * const de_ui_regs = chan;
+
+		/* pixel alpha times global alpha for argb */
+		writel(SUNXI_DE2_UI_CFG_ATTR_EN |
+		       SUNXI_DE2_UI_CFG_ATTR_ALPMOD(depth == 32 ? 2 : 1) |
+		       SUNXI_DE2_UI_CFG_ATTR_ALPHA(alpha) |
+		       SUNXI_DE2_UI_CFG_ATTR_FMT(fmt),
+		       &de_ui_regs->cfg[0].attr);
+		writel(size, &de_ui_regs->cfg[0].size);
+		writel(0, &de_ui_regs->cfg[0].coord);
+		writel(pitch, &de_ui_regs->cfg[0].pitch);
+		writel(address, &de_ui_regs->cfg[0].top_laddr);
+		writel(size, &de_ui_regs->ovl_size);
+	}
+
+	return 0;
+}
+
+void sunxi_composer_layer_disable(int channel)
+{
+	void *chan = SUNXI_DE2_MUX0_BASE + SUNXI_DE2_MUX_CHAN_REGS +
+		SUNXI_DE2_MUX_CHAN_SZ * channel;
+
+	/* enable is bit 0 of the first layer attr for both channel types */
+	clrbits_le32(chan, SUNXI_DE2_UI_CFG_ATTR_EN);
+}
+
+void sunxi_composer_pipe_set(int pipe, int channel, int x, int y,
+			     int width, int height)
+{
+	struct de_bld * const de_bld_regs =
+		(struct de_bld *)(SUNXI_DE2_MUX0_BASE +
+				  SUNXI_DE2_MUX_BLD_REGS);
+
+	clrsetbits_le32(&de_bld_regs->route, SUNXI_DE2_BLD_ROUTE(pipe, 0xf),
+			SUNXI_DE2_BLD_ROUTE(pipe, channel));
+	writel(SUNXI_DE2_WH(width, height), &de_bld_regs->attr[pipe].insize);
+	writel(SUNXI_DE2_XY(x, y), &de_bld_regs->attr[pipe].offset);
+	setbits_le32(&de_bld_regs->fcolor_ctl, SUNXI_DE2_BLD_PIPE_EN(pipe));
+}
+
+void sunxi_composer_pipe_disable(int pipe)
+{
+	struct de_bld * const de_bld_regs =
+		(struct de_bld *)(SUNXI_DE2_MUX0_BASE +
+				  SUNXI_DE2_MUX_BLD_REGS);
+
+	clrbits_le32(&de_bld_regs->fcolor_ctl, SUNXI_DE2_BLD_PIPE_EN(pipe));
+}
+
+/* Position only, for cursors and sprites that move on their own */
+void sunxi_composer_pipe_move(int pipe, int x, int y)
+{
+	struct de_bld * const de_bld_regs =
+		(struct de_bld *)(SUNXI_DE2_MUX0_BASE +
+				  SUNXI_DE2_MUX_BLD_REGS);
+
+	writel(SUNXI_DE2_XY(x, y), &de_bld_regs->attr[pipe].offset);
+	sunxi_composer_enable();
+}
+
+/*
+ * Keys cubic (a = -1/2), 16.16 fixed point in and out.
+ */
+static int sunxi_scaler_kernel(int x)
+{
+	s64 ax = x < 0 ? -x : x;
+	s64 ax2 = (ax * ax) >> 16;
+	s64 ax3 = (ax2 * ax) >> 16;
+
+	if (ax < 0x10000)
+		return (int)((3 * ax3 - 5 * ax2) / 2 + 0x10000);
+	if (ax < 0x20000)
+		return (int)((-ax3 + 5 * ax2 - 8 * ax) / 2 + 0x20000);
+	return 0;
+}
+
+/*
+ * Filter for a 16.16 step, one row of taps per phase. Taps are signed
+ * bytes summing to 64, packed four to a register, and tap taps/2 - 1
+ * is the sample itself at phase 0; the registers for taps 4-7 follow
+ * those for taps 0-3. When shrinking the kernel is widened by the
+ * ratio as far as the taps reach, so the source gets low-passed.
+ */
+static void sunxi_scaler_coef(u32 *coef, int phases, int taps, u32 step)
+{
+	int center = taps / 2 - 1;
+	u32 stretch = step > 0x10000 ? step : 0x10000;
+	u32 inv;
+	int w[8];
+	int p, t, x, sum, acc;
+
+	if (stretch > (u32)(taps / 4) << 16)
+		stretch = (taps / 4) << 16;
+	inv = 0xffffffffu / stretch;
+
+	for (p = 0; p < phases; p++) {
+		int frac = (p << 16) / phases;
+
+		sum = 0;
+		for (t = 0; t < taps; t++) {
+			x = ((t - center) << 16) - frac;
+			w[t] = sunxi_scaler_kernel((int)(((s64)x * inv) >> 16));
+			sum += w[t];
+		}
+
+		acc = 0;
+		for (t = 0; t < taps; t++) {
+			w[t] = (w[t] * 64 + (w[t] < 0 ? -sum : sum) / 2) / sum;
+			acc += w[t];
+		}
+		/* rounding leftovers go to the nearer of the two middle taps */
+		w[center + (frac >= 0x8000)] += 64 - acc;
+
+		for (t = 0; t < taps; t += 4)
+			coef[(t / 4) * phases + p] = (w[t] & 0xff) |
+				((w[t + 1] & 0xff) << 8) |
+				((w[t + 2] & 0xff) << 16) |
+				((w[t + 3] & 0xff) << 24);
+	}
+}
+
+/*
+ * Scale the layer of a channel from in_w x in_h to out_w x out_h, the
+ * channel then feeds its blender pipe at the output size. Equal sizes
+ * turn the scaler off.
+ */
+int sunxi_composer_scaler_set(int channel, int in_w, int in_h,
+			      int out_w, int out_h)
+{
+	void *base = sunxi_composer_scaler_base(channel);
+	u32 in = SUNXI_DE2_WH(in_w, in_h);
+	u32 out = SUNXI_DE2_WH(out_w, out_h);
+	u32 hstep, vstep;
+	u32 coef[64];
+	int i;
+
+	if (channel < 0 || channel >= SUNXI_DE2_MUX_CHAN_NUM)
+		return -EINVAL;
+	if (in_w == out_w && in_h == out_h) {
+		writel(0, base);
+		return 0;
+	}
+
+	hstep = ((u32)in_w << 16) / out_w;
+	vstep = ((u32)in_h << 16) / out_h;
+	/* the filters only reach that far */
+	if (hstep > 4 << 16 || vstep > 4 << 16)
+		return -EINVAL;
+
+	if (channel < SUNXI_DE2_MUX_VI_NUM) {
+		struct de_vsu * const vsu = base;
+
+		writel(out, &vsu->outsize);
+		writel(in, &vsu->y_insize);
+		writel(hstep << (SUNXI_DE2_SCALER_STEP_FRAC - 16), &vsu->y_hstep);
+		writel(vstep << (SUNXI_DE2_SCALER_STEP_FRAC - 16), &vsu->y_vstep);
+		writel(0, &vsu->y_hphase);
+		writel(0, &vsu->y_vphase[0]);
+		/* rgb, chroma runs at the luma rate */
+		writel(in, &vsu->c_insize);
+		writel(hstep << (SUNXI_DE2_SCALER_STEP_FRAC - 16), &vsu->c_hstep);
+		writel(vstep << (SUNXI_DE2_SCALER_STEP_FRAC - 16), &vsu->c_vstep);
+		writel(0, &vsu->c_hphase);
+		writel(0, &vsu->c_vphase[0]);
+
+		sunxi_scaler_coef(coef, 32, 8, hstep);
+		for (i = 0; i < 32; i++) {
+			writel(coef[i], &vsu->y_hcoef0[i]);
+			writel(coef[32 + i], &vsu->y_hcoef1[i]);
+			writel(coef[i], &vsu->c_hcoef0[i]);
+			writel(coef[32 + i], &vsu->c_hcoef1[i]);
+		}
+		sunxi_scaler_coef(coef, 32, 4, vstep);
+		for (i = 0; i < 32; i++) {
+			writel(coef[i], &vsu->y_vcoef[i]);
+			writel(coef[i], &vsu->c_vcoef[i]);
+		}
+	} else {
+		struct de_gsu * const gsu = base;
+
+		writel(out, &gsu->outsize);
+		writel(in, &gsu->insize);
+		writel(hstep << (SUNXI_DE2_SCALER_STEP_FRAC - 16), &gsu->hstep);
+		writel(vstep << (SUNXI_DE2_SCALER_STEP_FRAC - 16), &gsu->vstep);
+		writel(0, &gsu->hphase);
+		writel(0, &gsu->vphase);
+
+		sunxi_scaler_coef(coef, 16, 4, hstep);
+		for (i = 0; i < 16; i++)
+			writel(coef[i], &gsu->hcoef[i]);
+	}
+
+	writel(SUNXI_DE2_SCALER_CTRL_EN | SUNXI_DE2_SCALER_CTRL_COEF_SWITCH,
+	       base);
+	return 0;
+}
+
+void sunxi_composer_commit(void)
+{
+	sunxi_composer_enable();
+}
 #endif /* CONFIG_SUNXI_DE2 */
 
 /*
@@ -834,6 +1160,68 @@ static void sunxi_lcdc_enable(void)
 #endif
 }
 
+/*
+ * Vertical blank and line interrupts of the tcon driving the current
+ * monitor, lcd panels hang off tcon0 and everything else off tcon1.
+ */
+static bool sunxi_lcdc_irq_tcon0(void)
+{
+	if (sunxi_display.monitor == sunxi_monitor_lcd)
+		return true;
+#ifdef CONFIG_VIDEO_VGA_VIA_LCD
+	if (sunxi_display.monitor == sunxi_monitor_vga)
+		return true;
+#endif
+	return false;
+}
+
+/* line < 0 leaves the line interrupt off */
+void sunxi_lcdc_irq_enable(int vblank, int line)
+{
+	struct sunxi_lcdc_reg * const lcdc =
+		(struct sunxi_lcdc_reg *)SUNXI_LCD0_BASE;
+	bool tcon0 = sunxi_lcdc_irq_tcon0();
+	u32 vb = tcon0 ? SUNXI_LCDC_INT0_TCON0_VB_FLAG :
+			 SUNXI_LCDC_INT0_TCON1_VB_FLAG;
+	u32 ln = tcon0 ? SUNXI_LCDC_INT0_TCON0_LINE_FLAG :
+			 SUNXI_LCDC_INT0_TCON1_LINE_FLAG;
+
+	clrbits_le32(&lcdc->int0, vb | ln | ((vb | ln) << 16));
+	if (line >= 0) {
+		if (tcon0)
+			clrsetbits_le32(&lcdc->int1,
+					SUNXI_LCDC_INT1_TCON0_LINE(0xfff),
+					SUNXI_LCDC_INT1_TCON0_LINE(line));
+		else
+			clrsetbits_le32(&lcdc->int1,
+					SUNXI_LCDC_INT1_TCON1_LINE(0xfff),
+					SUNXI_LCDC_INT1_TCON1_LINE(line));
+		setbits_le32(&lcdc->int0, ln << 16);
+	}
+	if (vblank)
+		setbits_le32(&lcdc->int0, vb << 16);
+}
+
+/*
+ * Returns the pending interrupts, bit 0 for the vertical blank and bit 1
+ * for the line, and clears them.
+ */
+int sunxi_lcdc_irq_ack(void)
+{
+	struct sunxi_lcdc_reg * const lcdc =
+		(struct sunxi_lcdc_reg *)SUNXI_LCD0_BASE;
+	bool tcon0 = sunxi_lcdc_irq_tcon0();
+	u32 vb = tcon0 ? SUNXI_LCDC_INT0_TCON0_VB_FLAG :
+			 SUNXI_LCDC_INT0_TCON1_VB_FLAG;
+	u32 ln = tcon0 ? SUNXI_LCDC_INT0_TCON0_LINE_FLAG :
+			 SUNXI_LCDC_INT0_TCON1_LINE_FLAG;
+	u32 val = readl(&lcdc->int0) & (vb | ln);
+
+	if (val)
+		clrbits_le32(&lcdc->int0, val);
+	return (val & vb ? 1 : 0) | (val & ln ? 2 : 0);
+}
+
 static void sunxi_lcdc_panel_enable(void)
 {
 	int pin, reset_pin;
@@ -1513,16 +1901,94 @@ static enum sunxi_monitor sunxi_get_default_mon(bool allow_hdmi)
 		return sunxi_monitor_none;
 }
 
-void *video_hw_init_probe(void* fbbase, u8 *depth, u16* width, u16* height)
+static const struct ctfb_res_modes *video_hw_mode;
+static struct ctfb_res_modes video_hw_custom;
+
+/*
+ * What the hdmi probe found, kept by the caller across boots. When hpd
+ * shows up as quickly as last time only edid block 0 is read, and if it
+ * identifies the same display its cached mode is used. That skips the
+ * extension blocks, the timing parse and the wait for an absent display.
+ * Lcd panels have nothing to cache, their mode is the compiled-in
+ * CONFIG_VIDEO_LCD_MODE.
+ */
+#define SUNXI_MODE_CACHE_MAGIC	0x534d4332	/* "SMC2" */
+
+struct sunxi_mode_cache {
+	u32 magic;
+	u32 monitor;
+	u32 hpd_ms;		/* time hpd took to show up */
+	u32 edid_ident[SUNXI_EDID_IDENT_WORDS];
+	struct ctfb_res_modes mode;
+	u32 csum;
+};
+
+static struct sunxi_mode_cache sunxi_mode_cache;
+static bool sunxi_mode_cache_valid;
+
+static u32 sunxi_mode_cache_csum(const struct sunxi_mode_cache *cache)
+{
+	const u32 *p = (const u32 *)cache;
+	u32 csum = 0;
+	int i;
+
+	for (i = 0; i < offsetof(struct sunxi_mode_cache, csum) / 4; i++)
+		csum = ((csum << 5) | (csum >> 27)) ^ p[i];
+	return csum;
+}
+
+/* Hand in what video_hw_mode_save() returned on an earlier boot */
+int video_hw_mode_load(const void *buf, int size)
+{
+	struct sunxi_mode_cache cache;
+
+	sunxi_mode_cache_valid = false;
+	if (size != sizeof(cache))
+		return -EINVAL;
+	memcpy(&cache, buf, sizeof(cache));
+	if (cache.magic != SUNXI_MODE_CACHE_MAGIC ||
+	    cache.csum != sunxi_mode_cache_csum(&cache) ||
+	    (cache.monitor != sunxi_monitor_dvi &&
+	     cache.monitor != sunxi_monitor_hdmi))
+		return -EINVAL;
+
+	sunxi_mode_cache = cache;
+	sunxi_mode_cache_valid = true;
+	return 0;
+}
+
+/*
+ * Fill buf with what the last probe found, returns the size or 0 when
+ * there is nothing worth keeping.
+ */
+int video_hw_mode_save(void *buf, int size)
+{
+	if (!sunxi_mode_cache_valid)
+		return 0;
+	if (size < sizeof(sunxi_mode_cache))
+		return -ENOSPC;
+
+	sunxi_mode_cache.csum = sunxi_mode_cache_csum(&sunxi_mode_cache);
+	memcpy(buf, &sunxi_mode_cache, sizeof(sunxi_mode_cache));
+	return sizeof(sunxi_mode_cache);
+}
+
+/*
+ * Pick the monitor and its mode without touching the display engine, so
+ * the caller can size the framebuffer before video_hw_mode_set().
+ */
+int video_hw_mode_probe(u8 *depth, u16 *width, u16 *height)
 {
 	const struct ctfb_res_modes *mode;
 	struct ctfb_res_modes custom;
 	const char *options;
 #ifdef CONFIG_VIDEO_HDMI
 	int ret, hpd, hpd_delay, edid;
+	unsigned long start;
+	u32 ident[SUNXI_EDID_IDENT_WORDS];
+	bool cached;
 #endif
-	int i, overscan_offset, overscan_x, overscan_y;
-	unsigned int fb_dma_addr;
+	int i, overscan_x, overscan_y;
 	char mon[16];
 	char *lcd_mode = CONFIG_VIDEO_LCD_MODE;
 
@@ -1554,12 +2020,45 @@ void *video_hw_init_probe(void* fbbase, u8 *depth, u16* width, u16* height)
 	/* If HDMI/DVI is selected do HPD & EDID, and handle fallback */
 	if (sunxi_display.monitor == sunxi_monitor_dvi ||
 	    sunxi_display.monitor == sunxi_monitor_hdmi) {
-		/* Always call hdp_detect, as it also enables clocks, etc. */
-		ret = sunxi_hdmi_hpd_detect(hpd_delay);
+		/*
+		 * Always call hdp_detect, as it also enables clocks, etc. The
+		 * cached display gets twice the time it needed last boot, the
+		 * full hpd_delay only if it does not show up in that. Then it
+		 * has to present the same edid identity as last time.
+		 */
+		cached = edid && sunxi_mode_cache_valid;
+		start = timer_get_us();
+		ret = 0;
+		if (cached)
+			ret = sunxi_hdmi_hpd_detect(max(2 * (int)sunxi_mode_cache.hpd_ms, 20));
+		if (!ret) {
+			cached = false;
+			ret = sunxi_hdmi_hpd_detect(hpd_delay);
+		}
+		sunxi_mode_cache_valid = false;
 		if (ret) {
+			sunxi_mode_cache.hpd_ms =
+				(timer_get_us() - start + 999) / 1000;
 			printf("HDMI connected: ");
-			if (edid && sunxi_hdmi_edid_get_mode(&custom) == 0)
+			if (cached && (sunxi_hdmi_edid_get_ident(ident) ||
+			    memcmp(ident, sunxi_mode_cache.edid_ident,
+				   sizeof(ident))))
+				cached = false;
+			if (cached) {
+				custom = sunxi_mode_cache.mode;
+				sunxi_display.monitor = sunxi_mode_cache.monitor;
 				mode = &custom;
+				sunxi_mode_cache_valid = true;
+			} else if (edid &&
+				   sunxi_hdmi_edid_get_mode(&custom, ident) == 0) {
+				mode = &custom;
+				sunxi_mode_cache.magic = SUNXI_MODE_CACHE_MAGIC;
+				sunxi_mode_cache.monitor = sunxi_display.monitor;
+				memcpy(sunxi_mode_cache.edid_ident, ident,
+				       sizeof(ident));
+				sunxi_mode_cache.mode = custom;
+				sunxi_mode_cache_valid = true;
+			}
 		} else if (hpd) {
 			sunxi_hdmi_shutdown();
 			sunxi_display.monitor = sunxi_get_default_mon(false);
@@ -1569,20 +2068,20 @@ void *video_hw_init_probe(void* fbbase, u8 *depth, u16* width, u16* height)
 
 	switch (sunxi_display.monitor) {
 	case sunxi_monitor_none:
-		return NULL;
+		return -1;
 	case sunxi_monitor_dvi:
 	case sunxi_monitor_hdmi:
 		if (!sunxi_has_hdmi()) {
 			debug("HDMI/DVI not supported on this board\n");
 			sunxi_display.monitor = sunxi_monitor_none;
-			return NULL;
+			return -1;
 		}
 		break;
 	case sunxi_monitor_lcd:
 		if (!sunxi_has_lcd()) {
 			debug("LCD not supported on this board\n");
 			sunxi_display.monitor = sunxi_monitor_none;
-			return NULL;
+			return -1;
 		}
 		sunxi_display.depth = video_get_params(&custom, lcd_mode);
 		mode = &custom;
@@ -1591,7 +2090,7 @@ void *video_hw_init_probe(void* fbbase, u8 *depth, u16* width, u16* height)
 		if (!sunxi_has_vga()) {
 			debug("VGA not supported on this board\n");
 			sunxi_display.monitor = sunxi_monitor_none;
-			return NULL;
+			return -1;
 		}
 		sunxi_display.depth = 18;
 		break;
@@ -1602,7 +2101,7 @@ void *video_hw_init_probe(void* fbbase, u8 *depth, u16* width, u16* height)
 		if (!sunxi_has_composite()) {
 			debug("Composite video not supported on this board\n");
 			sunxi_display.monitor = sunxi_monitor_none;
-			return NULL;
+			return -1;
 		}
 		if (sunxi_display.monitor == sunxi_monitor_composite_pal ||
 		    sunxi_display.monitor == sunxi_monitor_composite_pal_nc)
@@ -1625,14 +2124,27 @@ void *video_hw_init_probe(void* fbbase, u8 *depth, u16* width, u16* height)
 	       sunxi_display.depth,
 	       sunxi_get_mon_desc(sunxi_display.monitor),
 	       overscan_x, overscan_y);
+
+	if (mode == &custom) {
+		video_hw_custom = custom;
+		mode = &video_hw_custom;
+	}
+	video_hw_mode = mode;
+
+	*depth = sunxi_display.depth;
+	*width = mode->xres;
+	*height = mode->yres;
+	return 0;
+}
+
+/* Start scanning out fbbase in the mode video_hw_mode_probe() picked */
+void video_hw_mode_set(void *fbbase)
+{
+	unsigned int fb_dma_addr;
+
 	sunxi_engines_init();
 
 	fb_dma_addr = (unsigned int)fbbase - CONFIG_SYS_SDRAM_BASE;
-	sunxi_mode_set(mode, fb_dma_addr);
-
-    *depth = sunxi_display.depth;
-    *width = mode->xres;
-    *height = mode->yres;
-	return fbbase;
+	sunxi_mode_set(video_hw_mode, fb_dma_addr);
 }
 
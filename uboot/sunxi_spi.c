@@ -29,14 +29,32 @@
 
 #define SUNXI_SPI_MAX_RATE (24 * 1000 * 1000)
 #define SUNXI_SPI_MIN_RATE (3 * 1000)
+#define SUNXI_SPI_MAX_BUS  2
+#define SUNXI_SPI_FIFO_DEPTH 64
+
+#define SUNXI_SPI_MODE_MASK	(SUNXI_SPI_CTL_CPOL | SUNXI_SPI_CTL_CPHA | \
+				 SUNXI_SPI_CTL_CS_ACTIVE_LOW)
 
 struct sunxi_spi_priv {
 	struct sunxi_spi_regs *regs;
 	unsigned int max_freq;
 	const char *name;
+	int bus;
+	uint32_t clk_ctl;	/* last value written to clk_ctl */
+	uint32_t mode_reg;	/* last mode bits written to xfer_ctl */
 	unsigned int activate_delay_us;
 	unsigned int deactivate_delay_us;
-	unsigned int last_transaction_us;
+	u64 last_transaction_us;
+	int cs_held;
+
+	/* interrupt driven transfer in flight, see sunxi_spi_xfer_async() */
+	const char *async_tx;
+	char *async_rx;
+	size_t async_tx_len;
+	size_t async_rx_len;
+	size_t async_left;
+	uint async_cs;
+	unsigned long async_flags;
 };
 
 static void sunxi_spi_enable_clock(struct sunxi_spi_priv *priv)
@@ -47,25 +65,25 @@ static void sunxi_spi_enable_clock(struct sunxi_spi_priv *priv)
 #if defined(CONFIG_MACH_SUN6I) || defined(CONFIG_MACH_SUN8I) || \
 	defined(CONFIG_MACH_SUN9I) || defined(CONFIG_MACH_SUN50I)
 	setbits_le32(&ccm->ahb_reset0_cfg,
-		(1 << AHB_GATE_OFFSET_SPI0));
+		(1 << (AHB_GATE_OFFSET_SPI0 + priv->bus)));
 #endif
 
-	setbits_le32(&ccm->ahb_gate0, (1 << AHB_GATE_OFFSET_SPI0));
-	writel((1 << 31), &ccm->spi0_clk_cfg);
+	setbits_le32(&ccm->ahb_gate0, (1 << (AHB_GATE_OFFSET_SPI0 + priv->bus)));
+	writel((1 << 31), &ccm->spi0_clk_cfg + priv->bus);
 }
 
-static void sunxi_spi_disable_clock(void)
+static void sunxi_spi_disable_clock(struct sunxi_spi_priv *priv)
 {
 	struct sunxi_ccm_reg * const ccm =
 		(struct sunxi_ccm_reg * const)SUNXI_CCM_BASE;
 
-	writel(0, &ccm->spi0_clk_cfg);
-	clrbits_le32(&ccm->ahb_gate0, (1 << AHB_GATE_OFFSET_SPI0));
+	writel(0, &ccm->spi0_clk_cfg + priv->bus);
+	clrbits_le32(&ccm->ahb_gate0, (1 << (AHB_GATE_OFFSET_SPI0 + priv->bus)));
 
 #if defined(CONFIG_MACH_SUN6I) || defined(CONFIG_MACH_SUN8I) || \
 	defined(CONFIG_MACH_SUN9I) || defined(CONFIG_MACH_SUN50I)
 	clrbits_le32(&ccm->ahb_reset0_cfg,
-		(1 << AHB_GATE_OFFSET_SPI0));
+		(1 << (AHB_GATE_OFFSET_SPI0 + priv->bus)));
 #endif
 }
 
@@ -73,11 +91,18 @@ static void sunxi_spi_cs_activate(struct sunxi_spi_priv *priv, unsigned int cs)
 {
 	uint32_t reg;
 
+	/*
+	 * CS is still asserted from an earlier message of the same sequence,
+	 * skip the register update and the activate/deactivate delays.
+	 */
+	if (priv->cs_held == (int)cs)
+		return;
+
 	/* If it is too soon to perform another transaction, wait. */
 	if (priv->deactivate_delay_us && priv->last_transaction_us) {
-		unsigned int delay_us;
+		u64 delay_us;
 
-		delay_us = timer_get_us() - priv->last_transaction_us;
+		delay_us = timer_get_boot_us() - priv->last_transaction_us;
 
 		if (delay_us < priv->deactivate_delay_us)
 			udelay(priv->deactivate_delay_us - delay_us);
@@ -89,6 +114,7 @@ static void sunxi_spi_cs_activate(struct sunxi_spi_priv *priv, unsigned int cs)
 	reg &= ~(SUNXI_SPI_CTL_CS_MASK | SUNXI_SPI_CTL_CS_LEVEL);
 	reg |= SUNXI_SPI_CTL_CS(cs);
 	writel(reg, &priv->regs->xfer_ctl);
+	priv->cs_held = cs;
 
 	if (priv->activate_delay_us)
 		udelay(priv->activate_delay_us);
@@ -104,13 +130,14 @@ static void sunxi_spi_cs_deactivate(struct sunxi_spi_priv *priv, unsigned int cs
 	reg &= ~SUNXI_SPI_CTL_CS_MASK;
 	reg |= SUNXI_SPI_CTL_CS_LEVEL;
 	writel(reg, &priv->regs->xfer_ctl);
+	priv->cs_held = -1;
 
 	/* 
 	 * Remember the time of this transaction so that we can honour the bus
 	 * delay.
 	 */
 	if (priv->deactivate_delay_us)
-		priv->last_transaction_us = timer_get_us();
+		priv->last_transaction_us = timer_get_boot_us();
 }
 
 int sunxi_spi_claim_bus(struct sunxi_spi_priv *priv)
@@ -129,6 +156,9 @@ int sunxi_spi_claim_bus(struct sunxi_spi_priv *priv)
 
 	setbits_le32(&priv->regs->xfer_ctl, SUNXI_SPI_CTL_CS_MANUAL |
 		SUNXI_SPI_CTL_CS_LEVEL);
+	priv->cs_held = -1;
+	priv->clk_ctl = ~0;
+	priv->mode_reg = ~0;
 	setbits_le32(&priv->regs->fifo_ctl, SUNXI_SPI_CTL_RF_RST |
 		SUNXI_SPI_CTL_TF_RST);
 
@@ -141,7 +171,7 @@ static int sunxi_spi_release_bus(struct sunxi_spi_priv *priv)
 
 	clrbits_le32(&priv->regs->glb_ctl, SUNXI_SPI_CTL_MASTER |
 		SUNXI_SPI_CTL_ENABLE);
-	sunxi_spi_disable_clock();
+	sunxi_spi_disable_clock(priv);
 
 	return 0;
 }
@@ -214,7 +244,131 @@ int sunxi_spi_xfer(struct sunxi_spi_priv *priv, unsigned int bitlen, uint cs,
 	return 0;
 }
 
-int sunxi_spi_set_speed(struct sunxi_spi_priv *priv, uint speed)
+static void sunxi_spi_fill_fifo(struct sunxi_spi_priv *priv)
+{
+	size_t cnt;
+
+	cnt = SUNXI_SPI_FIFO_DEPTH - ((readl(&priv->regs->fifo_sta) >>
+		SUNXI_SPI_FIFO_TF_CNT_BITS) & SUNXI_SPI_FIFO_TF_CNT_MASK);
+	cnt = min(cnt, priv->async_tx_len);
+	priv->async_tx_len -= cnt;
+
+	while (cnt--)
+		writeb(*priv->async_tx++, &priv->regs->tx_data);
+}
+
+static void sunxi_spi_drain_fifo(struct sunxi_spi_priv *priv)
+{
+	size_t cnt;
+	char byte;
+
+	cnt = (readl(&priv->regs->fifo_sta) & SUNXI_SPI_FIFO_RF_CNT_MASK) >>
+		SUNXI_SPI_FIFO_RF_CNT_BITS;
+	cnt = min(cnt, priv->async_rx_len);
+	priv->async_rx_len -= cnt;
+
+	while (cnt--) {
+		byte = readb(&priv->regs->rx_data);
+
+		if (priv->async_rx)
+			*priv->async_rx++ = byte;
+	}
+}
+
+static void sunxi_spi_async_burst(struct sunxi_spi_priv *priv)
+{
+	size_t nbytes = min(priv->async_left, (size_t)SUNXI_SPI_BURST_CNT(~0));
+	size_t tx_len = priv->async_tx ? nbytes : 0;
+	uint32_t irqs = SUNXI_SPI_INT_TC | SUNXI_SPI_INT_RF_RDY;
+
+	priv->async_left -= nbytes;
+	priv->async_tx_len = tx_len;
+	priv->async_rx_len = nbytes;
+
+	writel(SUNXI_SPI_BURST_CNT(nbytes), &priv->regs->burst_cnt);
+	writel(SUNXI_SPI_XMIT_CNT(tx_len), &priv->regs->xmit_cnt);
+	writel(SUNXI_SPI_BURST_CNT(tx_len), &priv->regs->burst_ctl);
+	sunxi_spi_fill_fifo(priv);
+
+	if (priv->async_tx_len)
+		irqs |= SUNXI_SPI_INT_TF_ERQ;
+
+	writel(~0, &priv->regs->int_sta);
+	writel(irqs, &priv->regs->int_ctl);
+	setbits_le32(&priv->regs->xfer_ctl, SUNXI_SPI_CTL_XCH);
+}
+
+/*
+ * Start an interrupt driven transfer. Unlike sunxi_spi_xfer() the whole
+ * message goes out as one burst with the FIFO refilled from the TX-empty
+ * and RX-ready interrupts, so there is no gap between 64-byte chunks.
+ * The caller's interrupt handler calls sunxi_spi_irq() until it reports
+ * completion.
+ */
+int sunxi_spi_xfer_async(struct sunxi_spi_priv *priv, unsigned int bitlen,
+	uint cs, const void *dout, void *din, unsigned long flags)
+{
+	if (bitlen % 8) {
+		debug("%s: non byte-aligned SPI transfer.\n", __func__);
+		return -1;
+	}
+
+	priv->async_tx = dout;
+	priv->async_rx = din;
+	priv->async_left = bitlen / 8;
+	priv->async_cs = cs;
+	priv->async_flags = flags;
+
+	writel(SUNXI_SPI_CTL_RF_TRIG(SUNXI_SPI_FIFO_DEPTH / 4 * 3) |
+		SUNXI_SPI_CTL_TF_TRIG(SUNXI_SPI_FIFO_DEPTH / 4),
+		&priv->regs->fifo_ctl);
+
+	if (flags & SPI_XFER_BEGIN)
+		sunxi_spi_cs_activate(priv, cs);
+
+	sunxi_spi_async_burst(priv);
+
+	return 0;
+}
+
+/* returns 1 once the transfer started by sunxi_spi_xfer_async() is done */
+int sunxi_spi_irq(struct sunxi_spi_priv *priv)
+{
+	uint32_t status = readl(&priv->regs->int_sta);
+
+	if (status & SUNXI_SPI_INT_TC) {
+		writel(SUNXI_SPI_INT_TC, &priv->regs->int_sta);
+		sunxi_spi_drain_fifo(priv);
+
+		if (priv->async_left) {
+			sunxi_spi_async_burst(priv);
+			return 0;
+		}
+
+		writel(0, &priv->regs->int_ctl);
+		if (priv->async_flags & SPI_XFER_END)
+			sunxi_spi_cs_deactivate(priv, priv->async_cs);
+
+		return 1;
+	}
+
+	if (status & SUNXI_SPI_INT_RF_RDY) {
+		sunxi_spi_drain_fifo(priv);
+		/* only clear the interrupt after draining the fifo */
+		writel(SUNXI_SPI_INT_RF_RDY, &priv->regs->int_sta);
+	}
+
+	if (status & SUNXI_SPI_INT_TF_ERQ) {
+		sunxi_spi_fill_fifo(priv);
+		if (!priv->async_tx_len)
+			clrbits_le32(&priv->regs->int_ctl, SUNXI_SPI_INT_TF_ERQ);
+		writel(SUNXI_SPI_INT_TF_ERQ, &priv->regs->int_sta);
+	}
+
+	return 0;
+}
+
+uint32_t sunxi_spi_speed_reg(uint speed)
 {
 	unsigned int div;
 	uint32_t reg;
@@ -234,20 +388,12 @@ int sunxi_spi_set_speed(struct sunxi_spi_priv *priv, uint speed)
 		reg = SUNXI_SPI_CLK_CTL_CDR1(div);
 	}
 
-	writel(reg, &priv->regs->clk_ctl);
-
-	debug("%s: speed=%u\n", __func__, speed);
-
-	return 0;
+	return reg;
 }
 
-int sunxi_spi_set_mode(struct sunxi_spi_priv *priv, uint mode)
+uint32_t sunxi_spi_mode_reg(uint mode)
 {
-	uint32_t reg;
-
-	reg = readl(&priv->regs->xfer_ctl);
-	reg &= ~(SUNXI_SPI_CTL_CPOL | SUNXI_SPI_CTL_CPHA |
-		SUNXI_SPI_CTL_CS_ACTIVE_LOW);
+	uint32_t reg = 0;
 
 	if (mode & SPI_CPOL)
 		reg |= SUNXI_SPI_CTL_CPOL;
@@ -258,21 +404,67 @@ int sunxi_spi_set_mode(struct sunxi_spi_priv *priv, uint mode)
 	if (!(mode & SPI_CS_HIGH))
 		reg |= SUNXI_SPI_CTL_CS_ACTIVE_LOW;
 
-	writel(reg, &priv->regs->xfer_ctl);
+	return reg;
+}
 
-	debug("%s: mode=%d\n", __func__, mode);
+/*
+ * Load a slave's precomputed clk_ctl and mode bits. Registers already
+ * holding the requested value are left alone, so switching between slaves
+ * with the same timing costs no bus register access at all.
+ */
+int sunxi_spi_load_regs(struct sunxi_spi_priv *priv, uint32_t clk_ctl,
+	uint32_t mode_reg)
+{
+	uint32_t reg;
+
+	if (priv->clk_ctl != clk_ctl) {
+		writel(clk_ctl, &priv->regs->clk_ctl);
+		priv->clk_ctl = clk_ctl;
+	}
+
+	if (priv->mode_reg != mode_reg) {
+		reg = readl(&priv->regs->xfer_ctl);
+		reg &= ~SUNXI_SPI_MODE_MASK;
+		reg |= mode_reg;
+		writel(reg, &priv->regs->xfer_ctl);
+		priv->mode_reg = mode_reg;
+	}
 
 	return 0;
 }
 
-static struct sunxi_spi_priv indev;
-int sunxi_spi_probe(const char *name, ulong reg, void **dev)
+int sunxi_spi_set_speed(struct sunxi_spi_priv *priv, uint speed)
+{
+	debug("%s: speed=%u\n", __func__, speed);
+
+	return sunxi_spi_load_regs(priv, sunxi_spi_speed_reg(speed),
+		priv->mode_reg);
+}
+
+int sunxi_spi_set_mode(struct sunxi_spi_priv *priv, uint mode)
 {
-	struct sunxi_spi_priv *priv = &indev;
+	debug("%s: mode=%d\n", __func__, mode);
+
+	return sunxi_spi_load_regs(priv, priv->clk_ctl,
+		sunxi_spi_mode_reg(mode));
+}
+
+static struct sunxi_spi_priv indev[SUNXI_SPI_MAX_BUS];
+int sunxi_spi_probe(const char *name, int bus, ulong reg, void **dev)
+{
+	struct sunxi_spi_priv *priv;
+
+	if (bus < 0 || bus >= SUNXI_SPI_MAX_BUS)
+		return -EINVAL;
 
+	priv = &indev[bus];
     priv->name = name;
+	priv->bus = bus;
 	priv->regs = (struct sunxi_spi_regs *)reg;
-	priv->last_transaction_us = timer_get_us();
+	priv->last_transaction_us = timer_get_boot_us();
+	priv->cs_held = -1;
+	priv->clk_ctl = ~0;
+	priv->mode_reg = ~0;
     *dev = priv;
 
 	return 0;
@@ -12,6 +12,7 @@
 #include <watchdog.h>
 
 #define TIMER_MODE   (0x0 << 7)	/* continuous mode */
+#define TIMER_SINGLE (0x1 << 7)	/* single mode */
 #define TIMER_DIV    (0x0 << 4)	/* pre scale 1 */
 #define TIMER_SRC    (0x1 << 2)	/* osc24m */
 #define TIMER_RELOAD (0x1 << 1)	/* reload internal value */
@@ -25,6 +26,7 @@
 
 static ulong TIMER_LOAD_VAL = TIMER_CLOCK;
 #define TIMER_NUM		0	/* we use timer 0 */
+#define HR_TIMER_NUM		1	/* timer 1 fires the hrtimers */
 
 /* read the 32-bit timer */
 ulong tick_read_timer(void)
@@ -48,11 +50,78 @@ int tick_timer_init(int tick)
 	writel(TIMER_LOAD_VAL, &timer->val);
 	writel(TIMER_LOAD_VAL, &timer->inter);
 	writel(TIMER_MODE | TIMER_DIV | TIMER_SRC | TIMER_RELOAD | TIMER_EN, &timer->ctl);
-	writel(1<<TIMER_NUM, &timers->tirqen);
+	setbits_le32(&timers->tirqen, 1 << TIMER_NUM);
 
 	return 0;
 }
 
+/*
+ * Mode changes follow the manual: stop the timer and give it a few
+ * cycles of its clock before loading a new interval.
+ */
+static void sunxi_timer_start(int num, ulong interval, u32 mode)
+{
+	struct sunxi_timer_reg *timers = (struct sunxi_timer_reg *)SUNXI_TIMER_BASE;
+	struct sunxi_timer *timer = &timers->timer[num];
+
+	clrbits_le32(&timer->ctl, TIMER_EN);
+	__udelay(1);
+	writel(interval, &timer->inter);
+	writel(mode | TIMER_DIV | TIMER_SRC | TIMER_RELOAD | TIMER_EN, &timer->ctl);
+}
+
+/* one interrupt after counts, for tickless idle */
+void tick_timer_oneshot(ulong counts)
+{
+	sunxi_timer_start(TIMER_NUM, counts, TIMER_SINGLE);
+}
+
+/*
+ * Back to one interrupt per tick, the first after first counts so the
+ * ticks stay in phase with the ones before the oneshot. The reload
+ * loaded first into the counter, the interval is a full tick again.
+ */
+void tick_timer_periodic(ulong first)
+{
+	struct sunxi_timer_reg *timers = (struct sunxi_timer_reg *)SUNXI_TIMER_BASE;
+	struct sunxi_timer *timer = &timers->timer[TIMER_NUM];
+
+	sunxi_timer_start(TIMER_NUM, first, TIMER_MODE);
+	/* the reload bit clears once first is in the counter */
+	while (readl(&timer->ctl) & TIMER_RELOAD)
+		;
+	writel(TIMER_LOAD_VAL, &timer->inter);
+}
+
+/* timer 1, one interrupt per programmed deadline */
+void hr_timer_init(void)
+{
+	struct sunxi_timer_reg *timers = (struct sunxi_timer_reg *)SUNXI_TIMER_BASE;
+
+	clrbits_le32(&timers->timer[HR_TIMER_NUM].ctl, TIMER_EN);
+	writel(1 << HR_TIMER_NUM, &timers->tirqsta);
+	setbits_le32(&timers->tirqen, 1 << HR_TIMER_NUM);
+}
+
+void hr_timer_oneshot(ulong counts)
+{
+	sunxi_timer_start(HR_TIMER_NUM, counts, TIMER_SINGLE);
+}
+
+void hr_timer_stop(void)
+{
+	struct sunxi_timer_reg *timers = (struct sunxi_timer_reg *)SUNXI_TIMER_BASE;
+
+	clrbits_le32(&timers->timer[HR_TIMER_NUM].ctl, TIMER_EN);
+}
+
+void hr_timer_ack(void)
+{
+	struct sunxi_timer_reg *timers = (struct sunxi_timer_reg *)SUNXI_TIMER_BASE;
+
+	writel(1 << HR_TIMER_NUM, &timers->tirqsta);
+}
+
 /* ack timer irq */
 int tick_timer_ack(void)
 {
@@ -62,35 +131,81 @@ int tick_timer_ack(void)
 	return 0;
 }
 
+/*
+ * The ARM generic timer counter is clocked from osc24m and is never
+ * reloaded, so unlike the tick timer above it is the free-running
+ * clocksource: 64 bits at 24 MHz, good for thousands of years, and it
+ * keeps counting when the tick is stopped. CNTPCT is always readable
+ * from PL1.
+ */
+uint64_t get_ticks(void)
+{
+	u64 cval;
+
+	asm volatile("isb" : : : "memory");
+	asm volatile("mrrc p15, 0, %Q0, %R0, c14" : "=r" (cval));
+	return cval;
+}
+
+ulong get_tbclk(void)
+{
+	return TIMER_CLOCK;
+}
+
+/* high 64 bits of a 64x64 bit product, four umull instead of a division */
+static inline u64 mul_u64_hi(u64 a, u64 b)
+{
+	u64 al = (u32)a, ah = a >> 32, bl = (u32)b, bh = b >> 32;
+	u64 lh = al * bh, hl = ah * bl;
+	u64 mid = ((al * bl) >> 32) + (u32)lh + (u32)hl;
+
+	return ah * bh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+/* exact floor(x / 3) for any x */
+static inline u64 div_u64_3(u64 x)
+{
+	return mul_u64_hi(x, 0xaaaaaaaaaaaaaaabULL) >> 1;
+}
+
+/* 24 counts per microsecond: (x / 8) / 3 */
+uint64_t timer_get_boot_us(void)
+{
+	return div_u64_3(get_ticks() >> 3);
+}
+
+/* 125 / 3 ns per count, the product overflows after 195 years */
+uint64_t timer_get_ns(void)
+{
+	return div_u64_3(get_ticks() * 125);
+}
+
+/* microseconds since boot, wraps after 2^32 us like the u-boot timebase */
+unsigned long timer_get_us(void)
+{
+	return (unsigned long)timer_get_boot_us();
+}
+
 /* delay x useconds */
 void __udelay(unsigned long usec)
 {
-	long tmo = USEC_TO_COUNT(usec);
-	ulong now, last = tick_read_timer();
+	u64 end = get_ticks() + USEC_TO_COUNT((u64)usec);
 
-	while (tmo > 0) {
-		now = tick_read_timer();
-		if (now > last)	/* normal (non rollover) */
-			tmo -= now - last;
-		else		/* rollover */
-			tmo -= TIMER_LOAD_VAL - last + now;
-		last = now;
-	}
+	while (get_ticks() < end)
+		;
 }
 
 #ifndef CONFIG_WD_PERIOD
 # define CONFIG_WD_PERIOD	(10 * 1000 * 1000)	/* 10 seconds default */
 #endif
 
-extern ulong rt_tick_get();
+/* milliseconds, from the clocksource so it runs without the tick */
 ulong get_timer(ulong base)
 {
-	return rt_tick_get() - base;
-}
+	/* us / 1000 = (us / 8) / 125, exact below 2^63 */
+	u64 ms = mul_u64_hi(timer_get_boot_us() >> 3, 0x20c49ba5e353f7cfULL) >> 4;
 
-unsigned long timer_get_us(void)
-{
-	return rt_tick_get() * 1000;
+	return (ulong)ms - base;
 }
 
 void udelay(unsigned long usec)